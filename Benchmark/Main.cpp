@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "../FilterPlugin/PluginProcessor.h"
+
+//==============================================================================
+// Headless benchmark for the FilterPlugin DSP. Instantiates the processor
+// without an editor and times processBlock over a sweep of sample rates,
+// channel counts, block sizes and filter algorithms.
+//
+// Usage: FilterBenchmark [--json <file>] [--seconds <s>] [--modulate]
+//                        [--rates 44100,48000,...] [--channels 1,2,...]
+//                        [--blocks 16,64,...] [--algorithms 0,1,...]
+//                        [--topology <n>] [--double] [--threads]
+namespace
+{
+    const std::vector<int> DEFAULT_SAMPLE_RATES = { 44100, 48000, 96000, 192000 };
+    const std::vector<int> DEFAULT_CHANNEL_COUNTS = { 1, 2, 8 };
+    const std::vector<int> DEFAULT_BLOCK_SIZES = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    constexpr double DEFAULT_SECONDS = 2.0;
+    constexpr int WARMUP_BLOCKS = 16;
+
+    struct BenchmarkCase
+    {
+        int sample_rate;
+        int num_channels;
+        int block_size;
+        int algorithm;
+        bool modulate;
+        int topology;
+        bool double_precision;
+        bool multithreading;
+    };
+
+    struct BenchmarkResult
+    {
+        double ns_per_sample = 0.0;
+        double samples_per_second = 0.0;
+        double realtime_factor = 0.0;
+        double block_p50_us = 0.0;
+        double block_p90_us = 0.0;
+        double block_p99_us = 0.0;
+        double block_max_us = 0.0;
+        int num_blocks = 0;
+        juce::uint64 allocations = 0;
+        juce::uint64 locks = 0;
+    };
+
+    std::vector<int> parseList(const juce::String& text)
+    {
+        std::vector<int> values;
+        for (auto& token : juce::StringArray::fromTokens(text, ",", ""))
+        {
+            if (token.trim().isNotEmpty())
+                values.push_back(token.trim().getIntValue());
+        }
+        return values;
+    }
+
+    void setParameter(FilterPluginAudioProcessor& processor, const juce::String& id, float value)
+    {
+        auto* parameter = processor.getParameterState()->getParameter(id);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    double percentile(std::vector<double> sorted, double fraction)
+    {
+        auto index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    template <typename SampleType>
+    BenchmarkResult runCase(const BenchmarkCase& c, double seconds)
+    {
+        FilterPluginAudioProcessor processor;
+        auto layout = juce::AudioChannelSet::discreteChannels(c.num_channels);
+        juce::AudioProcessor::BusesLayout buses;
+        buses.inputBuses.add(layout);
+        buses.inputBuses.add(juce::AudioChannelSet::disabled()); // sidechain
+        buses.outputBuses.add(layout);
+        processor.setBusesLayout(buses);
+
+        setParameter(processor, "filter_type", static_cast<float>(c.algorithm));
+        setParameter(processor, "fc", 1000.0f);
+        setParameter(processor, "Q", 0.707f);
+        setParameter(processor, "boost_cut", 6.0f);
+        setParameter(processor, "topology", static_cast<float>(c.topology));
+        setParameter(processor, "multithreading", c.multithreading ? 1.0f : 0.0f);
+
+        processor.setProcessingPrecision(c.double_precision ? juce::AudioProcessor::doublePrecision
+                                                            : juce::AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails(c.sample_rate, c.block_size);
+        processor.prepareToPlay(c.sample_rate, c.block_size);
+
+        // White noise at -12 dBFS, regenerated into the working buffer for
+        // every block so the filter never sees its own output
+        juce::Random random(1234);
+        juce::AudioBuffer<SampleType> source(c.num_channels, c.block_size * 8);
+        for (int channel = 0; channel < source.getNumChannels(); ++channel)
+        {
+            for (int i = 0; i < source.getNumSamples(); ++i)
+            {
+                source.setSample(channel, i, static_cast<SampleType>(0.25f * (2.0f * random.nextFloat() - 1.0f)));
+            }
+        }
+
+        juce::AudioBuffer<SampleType> buffer(c.num_channels, c.block_size);
+        juce::MidiBuffer midi;
+        const int num_blocks = std::max(1, static_cast<int>(seconds * c.sample_rate / c.block_size));
+        std::vector<double> block_times;
+        block_times.reserve(static_cast<size_t>(num_blocks));
+
+        const double ticks_per_second = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+        double total_seconds = 0.0;
+        for (int block = -WARMUP_BLOCKS; block < num_blocks; ++block)
+        {
+            const int offset = ((block + WARMUP_BLOCKS) % 8) * c.block_size;
+            for (int channel = 0; channel < c.num_channels; ++channel)
+            {
+                buffer.copyFrom(channel, 0, source, channel, offset, c.block_size);
+            }
+
+            if (c.modulate)
+            {
+                // A slow sweep across the audio range, so every block exercises
+                // the smoothing and coefficient update path
+                const double phase = static_cast<double>(block) * c.block_size / c.sample_rate;
+                setParameter(processor, "fc", static_cast<float>(1000.0 * std::pow(10.0, std::sin(phase))));
+            }
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            processor.processBlock(buffer, midi);
+            const auto end = juce::Time::getHighResolutionTicks();
+
+            if (block < 0)
+                continue;
+
+            const double elapsed = static_cast<double>(end - start) / ticks_per_second;
+            block_times.push_back(elapsed);
+            total_seconds += elapsed;
+        }
+        // Zero unless built with FILTERPLUGIN_INSTRUMENTATION
+        const auto audio_thread = processor.getAudioThreadMonitor().getStatistics();
+        processor.releaseResources();
+
+        std::sort(block_times.begin(), block_times.end());
+        const double total_samples = static_cast<double>(num_blocks) * c.block_size;
+
+        BenchmarkResult result;
+        result.num_blocks = num_blocks;
+        result.ns_per_sample = 1.0e9 * total_seconds / (total_samples * c.num_channels);
+        result.samples_per_second = total_samples * c.num_channels / total_seconds;
+        result.realtime_factor = (total_samples / c.sample_rate) / total_seconds;
+        result.block_p50_us = 1.0e6 * percentile(block_times, 0.5);
+        result.block_p90_us = 1.0e6 * percentile(block_times, 0.9);
+        result.block_p99_us = 1.0e6 * percentile(block_times, 0.99);
+        result.block_max_us = 1.0e6 * block_times.back();
+        result.allocations = audio_thread.allocations;
+        result.locks = audio_thread.locks;
+        return result;
+    }
+
+    juce::var toJSON(const BenchmarkCase& c, const BenchmarkResult& r)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty("sample_rate", c.sample_rate);
+        object->setProperty("channels", c.num_channels);
+        object->setProperty("block_size", c.block_size);
+        object->setProperty("algorithm", c.algorithm);
+        object->setProperty("algorithm_name", juce::String(rubdsp::filterAlgorithmStrings[c.algorithm]));
+        object->setProperty("modulated", c.modulate);
+        object->setProperty("topology", c.topology);
+        object->setProperty("double_precision", c.double_precision);
+        object->setProperty("multithreading", c.multithreading);
+        object->setProperty("blocks", r.num_blocks);
+        object->setProperty("ns_per_sample", r.ns_per_sample);
+        object->setProperty("samples_per_second", r.samples_per_second);
+        object->setProperty("realtime_factor", r.realtime_factor);
+        object->setProperty("block_p50_us", r.block_p50_us);
+        object->setProperty("block_p90_us", r.block_p90_us);
+        object->setProperty("block_p99_us", r.block_p99_us);
+        object->setProperty("block_max_us", r.block_max_us);
+        object->setProperty("audio_thread_allocations", static_cast<juce::int64>(r.allocations));
+        object->setProperty("audio_thread_locks", static_cast<juce::int64>(r.locks));
+        return juce::var(object);
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The parameter tree and its listeners expect a message manager
+    juce::ScopedJuceInitialiser_GUI juce_initialiser;
+
+    juce::ArgumentList arguments(argc, argv);
+
+    auto sample_rates = DEFAULT_SAMPLE_RATES;
+    auto channel_counts = DEFAULT_CHANNEL_COUNTS;
+    auto block_sizes = DEFAULT_BLOCK_SIZES;
+    std::vector<int> algorithms;
+    for (int algorithm = 0; algorithm < rubdsp::filterAlgorithm::NUM_ALGROITHMS; ++algorithm)
+    {
+        algorithms.push_back(algorithm);
+    }
+
+    if (arguments.containsOption("--rates"))
+        sample_rates = parseList(arguments.getValueForOption("--rates"));
+    if (arguments.containsOption("--channels"))
+        channel_counts = parseList(arguments.getValueForOption("--channels"));
+    if (arguments.containsOption("--blocks"))
+        block_sizes = parseList(arguments.getValueForOption("--blocks"));
+    if (arguments.containsOption("--algorithms"))
+        algorithms = parseList(arguments.getValueForOption("--algorithms"));
+
+    const double seconds = arguments.containsOption("--seconds")
+                         ? arguments.getValueForOption("--seconds").getDoubleValue()
+                         : DEFAULT_SECONDS;
+    const bool modulate = arguments.containsOption("--modulate");
+    const bool double_precision = arguments.containsOption("--double");
+    const bool multithreading = arguments.containsOption("--threads");
+    const int topology = arguments.containsOption("--topology")
+                       ? arguments.getValueForOption("--topology").getIntValue()
+                       : 0;
+
+    for (auto algorithm : algorithms)
+    {
+        if (algorithm < 0 || algorithm >= rubdsp::filterAlgorithm::NUM_ALGROITHMS)
+        {
+            std::cerr << "Unknown filter algorithm " << algorithm << std::endl;
+            return 1;
+        }
+    }
+
+    if (topology < 0 || topology >= TOPOLOGY_NAMES.size())
+    {
+        std::cerr << "Unknown filter topology " << topology << std::endl;
+        return 1;
+    }
+
+    juce::Array<juce::var> results;
+    std::cout << juce::String::formatted("%8s %4s %6s %-28s %10s %10s %10s %10s %10s",
+                                         "rate", "ch", "block", "algorithm", "ns/sample", "x realtime",
+                                         "p50 us", "p99 us", "max us") << std::endl;
+
+    for (auto sample_rate : sample_rates)
+    {
+        for (auto num_channels : channel_counts)
+        {
+            for (auto block_size : block_sizes)
+            {
+                for (auto algorithm : algorithms)
+                {
+                    BenchmarkCase c { sample_rate, num_channels, block_size, algorithm, modulate, topology, double_precision, multithreading };
+                    auto result = double_precision ? runCase<double>(c, seconds) : runCase<float>(c, seconds);
+                    results.add(toJSON(c, result));
+
+                    std::cout << juce::String::formatted("%8d %4d %6d %-28s %10.3f %10.1f %10.2f %10.2f %10.2f",
+                                                         sample_rate, num_channels, block_size,
+                                                         rubdsp::filterAlgorithmStrings[algorithm].c_str(),
+                                                         result.ns_per_sample, result.realtime_factor,
+                                                         result.block_p50_us, result.block_p99_us,
+                                                         result.block_max_us) << std::endl;
+                }
+            }
+        }
+    }
+
+    if (arguments.containsOption("--json"))
+    {
+        auto* report = new juce::DynamicObject();
+        report->setProperty("plugin", juce::String(JucePlugin_Name));
+        report->setProperty("version", juce::String(JucePlugin_VersionString));
+        report->setProperty("seconds_per_case", seconds);
+        report->setProperty("results", results);
+
+        juce::File file = juce::File::getCurrentWorkingDirectory().getChildFile(arguments.getValueForOption("--json"));
+        if (!file.replaceWithText(juce::JSON::toString(juce::var(report))))
+        {
+            std::cerr << "Could not write " << file.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "AudioThreadMonitor.h"
+
+#if FILTERPLUGIN_INSTRUMENTATION
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//==============================================================================
+// Replacement global allocation functions that report to the monitor of the
+// calling thread. They take effect for the whole binary the plugin is linked
+// into: reliably in the Standalone and the benchmark, and for the plugin's own
+// code in hosts where the plugin binds its symbols locally. Aligned new and
+// delete go straight to the C library and aren't counted.
+void* operator new(std::size_t size)
+{
+    AudioThreadMonitor::noteAllocation();
+    if (auto* p = std::malloc(size != 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    AudioThreadMonitor::noteAllocation();
+    return std::malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+// Freeing can take the allocator's locks just as well, so it counts too
+void operator delete(void* p) noexcept
+{
+    if (p != nullptr)
+        AudioThreadMonitor::noteAllocation();
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+//==============================================================================
+// Mutex hook. glibc lets an executable (or a library loaded before libc's
+// users) interpose pthread_mutex_lock, which covers juce::CriticalSection and
+// std::mutex alike. There is no equivalent without a dynamic loader trick on
+// macOS or Windows, so only allocations are tracked there.
+#if defined(__GLIBC__)
+#include <dlfcn.h>
+#include <pthread.h>
+
+namespace
+{
+    using LockFunction = int (*)(pthread_mutex_t*);
+
+    // Resolved on first use without a function-local static, whose guard may
+    // itself lock a mutex
+    std::atomic<LockFunction> next_mutex_lock { nullptr };
+}
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) __THROW
+{
+    auto next = next_mutex_lock.load(std::memory_order_relaxed);
+    if (next == nullptr)
+    {
+        next = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+        next_mutex_lock.store(next, std::memory_order_relaxed);
+    }
+
+    AudioThreadMonitor::noteLock();
+    return next(mutex);
+}
+#endif
+
+#endif
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+#include <juce_core/juce_core.h>
+
+// Configure with -DFILTERPLUGIN_INSTRUMENTATION=ON to compile the monitor in.
+// Without it ScopedBlock is empty and the hooks don't exist.
+#ifndef FILTERPLUGIN_INSTRUMENTATION
+    #define FILTERPLUGIN_INSTRUMENTATION 0
+#endif
+
+namespace
+{
+    // Bucket 0 holds blocks under 1 us, bucket k blocks of [2^(k-1), 2^k) us,
+    // the last one everything longer.
+    constexpr int MONITOR_NUM_BUCKETS = 24;
+}
+
+//==============================================================================
+// Opt-in instrumentation of the audio thread. ScopedBlock times one
+// processBlock call with the high-resolution tick counter into a histogram
+// and tracks the fraction of the buffer period it used. While a block is
+// being timed, the hooks in AudioThreadMonitor.cpp count every heap
+// allocation and mutex lock made on that thread. The audio thread is the only
+// writer, so it only does relaxed atomic stores and never waits; readers get
+// a view that may be a block behind.
+class AudioThreadMonitor
+{
+public:
+    struct Statistics
+    {
+        std::array<juce::uint64, MONITOR_NUM_BUCKETS> histogram {};
+        juce::uint64 blocks = 0;
+        juce::uint64 overruns = 0;
+        juce::uint64 allocations = 0;
+        juce::uint64 locks = 0;
+        double mean_load = 0.0;
+        double max_load = 0.0;
+        double max_block_us = 0.0;
+
+        // Upper edge of the bucket the given fraction of blocks falls in.
+        double percentileMicroseconds(double fraction) const
+        {
+            if (blocks == 0)
+                return 0.0;
+
+            const auto target = static_cast<juce::uint64>(fraction * static_cast<double>(blocks));
+            juce::uint64 count = 0;
+            for (int bucket = 0; bucket < MONITOR_NUM_BUCKETS; ++bucket)
+            {
+                count += histogram[static_cast<size_t>(bucket)];
+                if (count > target)
+                    return static_cast<double>(juce::uint64(1) << bucket);
+            }
+            return max_block_us;
+        }
+    };
+
+    // Message thread, from prepareToPlay.
+    void prepare(double sampleRate)
+    {
+        _sample_rate = sampleRate;
+        reset();
+    }
+
+    void reset()
+    {
+        for (auto& bucket : _histogram)
+            bucket.store(0, std::memory_order_relaxed);
+        _blocks.store(0, std::memory_order_relaxed);
+        _overruns.store(0, std::memory_order_relaxed);
+        _allocations.store(0, std::memory_order_relaxed);
+        _locks.store(0, std::memory_order_relaxed);
+        _busy_ticks.store(0, std::memory_order_relaxed);
+        _samples.store(0, std::memory_order_relaxed);
+        _max_ticks.store(0, std::memory_order_relaxed);
+        _max_load.store(0.0, std::memory_order_relaxed);
+    }
+
+    // Audio thread, around the whole of processBlock.
+    class ScopedBlock
+    {
+    public:
+#if FILTERPLUGIN_INSTRUMENTATION
+        ScopedBlock(AudioThreadMonitor& monitor, int numSamples)
+            : _monitor(monitor), _num_samples(numSamples), _previous(current)
+        {
+            current = &_monitor;
+            _start = juce::Time::getHighResolutionTicks();
+        }
+
+        ~ScopedBlock()
+        {
+            const auto elapsed = juce::Time::getHighResolutionTicks() - _start;
+            current = _previous;
+            _monitor.record(elapsed, _num_samples);
+        }
+
+    private:
+        AudioThreadMonitor& _monitor;
+        int _num_samples;
+        AudioThreadMonitor* _previous;
+        juce::int64 _start = 0;
+#else
+        ScopedBlock(AudioThreadMonitor&, int) {}
+#endif
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedBlock)
+    };
+
+    // Called by the hooks from whatever thread allocates or locks; only
+    // counts while that thread is inside a ScopedBlock, which makes it the
+    // monitor's only writer.
+    static void noteAllocation()
+    {
+        if (auto* monitor = current)
+            increment(monitor->_allocations);
+    }
+
+    static void noteLock()
+    {
+        if (auto* monitor = current)
+            increment(monitor->_locks);
+    }
+
+    // Any thread.
+    Statistics getStatistics() const
+    {
+        Statistics statistics;
+        for (size_t bucket = 0; bucket < _histogram.size(); ++bucket)
+            statistics.histogram[bucket] = _histogram[bucket].load(std::memory_order_relaxed);
+        statistics.blocks = _blocks.load(std::memory_order_relaxed);
+        statistics.overruns = _overruns.load(std::memory_order_relaxed);
+        statistics.allocations = _allocations.load(std::memory_order_relaxed);
+        statistics.locks = _locks.load(std::memory_order_relaxed);
+        statistics.max_load = _max_load.load(std::memory_order_relaxed);
+
+        const double ticks_per_second = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+        const auto samples = _samples.load(std::memory_order_relaxed);
+        if (samples > 0)
+        {
+            const double busy_seconds = static_cast<double>(_busy_ticks.load(std::memory_order_relaxed)) / ticks_per_second;
+            statistics.mean_load = busy_seconds * _sample_rate / static_cast<double>(samples);
+        }
+        statistics.max_block_us = 1.0e6 * static_cast<double>(_max_ticks.load(std::memory_order_relaxed)) / ticks_per_second;
+        return statistics;
+    }
+
+    // Message thread. Writes the statistics and histogram as JSON.
+    bool writeReport(const juce::File& file) const
+    {
+        const auto statistics = getStatistics();
+
+        juce::Array<juce::var> histogram;
+        for (int bucket = 0; bucket < MONITOR_NUM_BUCKETS; ++bucket)
+        {
+            auto* entry = new juce::DynamicObject();
+            entry->setProperty("below_us", static_cast<juce::int64>(juce::uint64(1) << bucket));
+            entry->setProperty("blocks", static_cast<juce::int64>(statistics.histogram[static_cast<size_t>(bucket)]));
+            histogram.add(juce::var(entry));
+        }
+
+        auto* report = new juce::DynamicObject();
+        report->setProperty("instrumented", FILTERPLUGIN_INSTRUMENTATION != 0);
+        report->setProperty("sample_rate", _sample_rate);
+        report->setProperty("blocks", static_cast<juce::int64>(statistics.blocks));
+        report->setProperty("overruns", static_cast<juce::int64>(statistics.overruns));
+        report->setProperty("allocations", static_cast<juce::int64>(statistics.allocations));
+        report->setProperty("locks", static_cast<juce::int64>(statistics.locks));
+        report->setProperty("mean_load", statistics.mean_load);
+        report->setProperty("max_load", statistics.max_load);
+        report->setProperty("block_p50_us", statistics.percentileMicroseconds(0.5));
+        report->setProperty("block_p99_us", statistics.percentileMicroseconds(0.99));
+        report->setProperty("block_max_us", statistics.max_block_us);
+        report->setProperty("histogram", histogram);
+        return file.replaceWithText(juce::JSON::toString(juce::var(report)));
+    }
+
+private:
+    void record(juce::int64 elapsedTicks, int numSamples)
+    {
+        const double ticks_per_second = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+        const auto ticks = static_cast<juce::uint64>(std::max<juce::int64>(elapsedTicks, 0));
+        auto microseconds = static_cast<juce::uint64>(1.0e6 * static_cast<double>(ticks) / ticks_per_second);
+        int bucket = 0;
+        while (microseconds > 0 && bucket < MONITOR_NUM_BUCKETS - 1)
+        {
+            microseconds >>= 1;
+            ++bucket;
+        }
+        increment(_histogram[static_cast<size_t>(bucket)]);
+        increment(_blocks);
+
+        _busy_ticks.store(_busy_ticks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+        _samples.store(_samples.load(std::memory_order_relaxed) + static_cast<juce::uint64>(numSamples), std::memory_order_relaxed);
+        if (ticks > _max_ticks.load(std::memory_order_relaxed))
+            _max_ticks.store(ticks, std::memory_order_relaxed);
+
+        if (numSamples > 0 && _sample_rate > 0.0)
+        {
+            const double load = static_cast<double>(ticks) / ticks_per_second * _sample_rate / numSamples;
+            if (load > _max_load.load(std::memory_order_relaxed))
+                _max_load.store(load, std::memory_order_relaxed);
+            if (load > 1.0)
+                increment(_overruns);
+        }
+    }
+
+    // Single writer, so a load and a store is enough and cheaper than an RMW
+    static void increment(std::atomic<juce::uint64>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // The monitor whose block the current thread is inside, if any
+    inline static thread_local AudioThreadMonitor* current = nullptr;
+
+    double _sample_rate = 44100.0;
+    std::array<std::atomic<juce::uint64>, MONITOR_NUM_BUCKETS> _histogram {};
+    std::atomic<juce::uint64> _blocks { 0 };
+    std::atomic<juce::uint64> _overruns { 0 };
+    std::atomic<juce::uint64> _allocations { 0 };
+    std::atomic<juce::uint64> _locks { 0 };
+    std::atomic<juce::uint64> _busy_ticks { 0 };
+    std::atomic<juce::uint64> _samples { 0 };
+    std::atomic<juce::uint64> _max_ticks { 0 };
+    std::atomic<double> _max_load { 0.0 };
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "AudioThreadMonitor.h"
+
+//==============================================================================
+// One line of audio thread statistics, refreshed a few times a second, and a
+// button that dumps the full report next to the user's documents.
+class AudioThreadMonitorView : public juce::Component, private juce::Timer
+{
+public:
+    explicit AudioThreadMonitorView(AudioThreadMonitor& monitor)
+        : _monitor(monitor)
+    {
+        addAndMakeVisible(_label);
+        _label.setFont(juce::Font(12.0f));
+        _label.setJustificationType(juce::Justification::centredLeft);
+
+        addAndMakeVisible(_dump_button);
+        _dump_button.onClick = [this] { dump(); };
+
+        startTimerHz(4);
+        timerCallback();
+    }
+
+    void resized() override
+    {
+        auto bounds = getLocalBounds();
+        _dump_button.setBounds(bounds.removeFromRight(60).reduced(2));
+        _label.setBounds(bounds);
+    }
+
+private:
+    void timerCallback() override
+    {
+        const auto statistics = _monitor.getStatistics();
+        auto text = juce::String::formatted("p50 %.0f us  p99 %.0f us  max %.0f us  load %.0f%% (peak %.0f%%)",
+                                            statistics.percentileMicroseconds(0.5),
+                                            statistics.percentileMicroseconds(0.99),
+                                            statistics.max_block_us,
+                                            100.0 * statistics.mean_load,
+                                            100.0 * statistics.max_load);
+        text << "  overruns " << juce::String(static_cast<juce::int64>(statistics.overruns))
+             << "  allocations " << juce::String(static_cast<juce::int64>(statistics.allocations))
+             << "  locks " << juce::String(static_cast<juce::int64>(statistics.locks));
+        _label.setText(text, juce::dontSendNotification);
+
+        const bool violated = statistics.allocations > 0 || statistics.locks > 0 || statistics.overruns > 0;
+        _label.setColour(juce::Label::textColourId, violated ? juce::Colours::orangered
+                                                             : findColour(juce::Label::textColourId, true));
+    }
+
+    void dump()
+    {
+        auto file = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                        .getNonexistentChildFile("FilterPlugin audio thread", ".json");
+        const bool written = _monitor.writeReport(file);
+        _dump_button.setTooltip(written ? "Wrote " + file.getFullPathName()
+                                        : "Could not write " + file.getFullPathName());
+    }
+
+    AudioThreadMonitor& _monitor;
+    juce::Label _label;
+    juce::TextButton _dump_button { "Dump" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioThreadMonitorView)
+};
@@ -0,0 +1,469 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define FILTERPLUGIN_USE_AVX 1
+    #define FILTERPLUGIN_USE_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define FILTERPLUGIN_USE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define FILTERPLUGIN_USE_NEON 1
+#endif
+
+//==============================================================================
+// Direct form coefficients of a single second-order section, normalised so
+// that a0 == 1. First-order sections simply leave b2 and a2 at zero.
+struct BiquadCoefficients
+{
+    double b0 = 1.0;
+    double b1 = 0.0;
+    double b2 = 0.0;
+    double a1 = 0.0;
+    double a2 = 0.0;
+};
+
+// Longest cascade of second-order sections run per channel (8th order).
+constexpr int MAX_FILTER_SECTIONS = 4;
+
+// The same section as a topology-preserving (trapezoidal) state variable
+// filter: g = tan(w/2), k = 1/Q of the bilinear-transformed prototype, and
+// the output mix y = m0 * x + m1 * band + m2 * low.
+struct SvfCoefficients
+{
+    double g = 1.0;
+    double k = 2.0;
+    double m0 = 1.0;
+    double m1 = 0.0;
+    double m2 = 0.0;
+};
+
+// Maps a stable biquad onto the state variable filter with the same transfer
+// function, by matching the denominators and the gains at DC, Nyquist and
+// in between.
+inline SvfCoefficients toSvf(const BiquadCoefficients& c)
+{
+    const double p = 1.0 + c.a1 + c.a2; // 4 g^2 / (1 + g k + g^2)
+    const double q = 1.0 - c.a1 + c.a2; // 4 / (1 + g k + g^2)
+    if (p <= 0.0 || q <= 0.0)
+        return {}; // outside the stability triangle, leave it a pass-through
+
+    SvfCoefficients svf;
+    svf.g = std::sqrt(p / q);
+    svf.k = 2.0 * (1.0 - c.a2) / (q * svf.g);
+
+    const double nyquist = (c.b0 - c.b1 + c.b2) / q;
+    const double dc = (c.b0 + c.b1 + c.b2) / p;
+    const double middle = (4.0 * c.b0 / q - nyquist - dc * svf.g * svf.g) / svf.g;
+    svf.m0 = nyquist;
+    svf.m1 = middle - nyquist * svf.k;
+    svf.m2 = dc - nyquist;
+    return svf;
+}
+
+// The inverse of toSvf. Any g > 0 and k > 0 gives a stable biquad.
+inline BiquadCoefficients fromSvf(const SvfCoefficients& svf)
+{
+    const double g2 = svf.g * svf.g;
+    const double a0 = 1.0 + svf.g * svf.k + g2;
+    const double p = 4.0 * g2 / a0;
+    const double q = 4.0 / a0;
+
+    const double nyquist = svf.m0;
+    const double dc = svf.m0 + svf.m2;
+    const double middle = svf.m1 + svf.m0 * svf.k;
+
+    BiquadCoefficients c;
+    c.a1 = 2.0 * (g2 - 1.0) / a0;
+    c.a2 = (1.0 - svf.g * svf.k + g2) / a0;
+    c.b0 = q * (nyquist + middle * svf.g + dc * g2) / 4.0;
+    c.b1 = (dc * p - nyquist * q) / 2.0;
+    c.b2 = (dc * p + nyquist * q) / 2.0 - c.b0;
+    return c;
+}
+
+enum class FilterTopology
+{
+    transposed_direct_form_2 = 0,
+    state_variable
+};
+
+// The cheapest kernel that runs a section exactly, ordered so that a ramp
+// between two sections needs the larger of their kernels.
+enum class SectionKernel
+{
+    bypass = 0,     // numerator equals denominator, e.g. any gain type at 0 dB (direct form only)
+    first_order,    // b2 and a2 are zero, one state per channel
+    second_order,
+    state_variable,
+    num_kernels
+};
+
+// Relative size below which a tap counts as zero
+constexpr double SECTION_TAP_TOLERANCE = 1e-12;
+
+// A state variable filter's integrators follow the input even when the mix
+// ignores them, so it can never stop running.
+inline SectionKernel classifySection(const BiquadCoefficients& c, FilterTopology topology)
+{
+    if (topology == FilterTopology::state_variable)
+        return SectionKernel::state_variable;
+
+    const double scale = std::abs(c.b0) + std::abs(c.b1) + std::abs(c.b2) + 1.0;
+    const double tolerance = SECTION_TAP_TOLERANCE * scale;
+    if (std::abs(c.b0 - 1.0) <= tolerance && std::abs(c.b1 - c.a1) <= tolerance && std::abs(c.b2 - c.a2) <= tolerance)
+        return SectionKernel::bypass;
+    if (c.a2 == 0.0 && std::abs(c.b2) <= tolerance)
+        return SectionKernel::first_order;
+    return SectionKernel::second_order;
+}
+
+//==============================================================================
+// Thin wrappers over one register of doubles. Each lane carries one channel,
+// samples are gathered from and scattered to the planar channel pointers,
+// which may hold floats or doubles.
+struct ScalarVector
+{
+    static constexpr int size = 1;
+    double v;
+
+    static ScalarVector load(const double* p) { return { *p }; }
+    static ScalarVector broadcast(double x) { return { x }; }
+    template <typename SampleType>
+    static ScalarVector gather(SampleType* const* channels, int sample) { return { static_cast<double>(channels[0][sample]) }; }
+    void store(double* p) const { *p = v; }
+    template <typename SampleType>
+    void scatter(SampleType* const* channels, int sample) const { channels[0][sample] = static_cast<SampleType>(v); }
+
+    friend ScalarVector operator+(ScalarVector a, ScalarVector b) { return { a.v + b.v }; }
+    friend ScalarVector operator-(ScalarVector a, ScalarVector b) { return { a.v - b.v }; }
+    friend ScalarVector operator*(ScalarVector a, ScalarVector b) { return { a.v * b.v }; }
+    friend ScalarVector operator/(ScalarVector a, ScalarVector b) { return { a.v / b.v }; }
+};
+
+#if FILTERPLUGIN_USE_AVX
+struct SimdVector
+{
+    static constexpr int size = 4;
+    __m256d v;
+
+    static SimdVector load(const double* p) { return { _mm256_loadu_pd(p) }; }
+    static SimdVector broadcast(double x) { return { _mm256_set1_pd(x) }; }
+    template <typename SampleType>
+    static SimdVector gather(SampleType* const* channels, int sample)
+    {
+        return { _mm256_set_pd(channels[3][sample], channels[2][sample], channels[1][sample], channels[0][sample]) };
+    }
+    void store(double* p) const { _mm256_storeu_pd(p, v); }
+    template <typename SampleType>
+    void scatter(SampleType* const* channels, int sample) const
+    {
+        if constexpr (std::is_same<SampleType, float>::value)
+        {
+            alignas(16) float out[4];
+            _mm_store_ps(out, _mm256_cvtpd_ps(v));
+            channels[0][sample] = out[0];
+            channels[1][sample] = out[1];
+            channels[2][sample] = out[2];
+            channels[3][sample] = out[3];
+        }
+        else
+        {
+            alignas(32) double out[4];
+            _mm256_store_pd(out, v);
+            channels[0][sample] = out[0];
+            channels[1][sample] = out[1];
+            channels[2][sample] = out[2];
+            channels[3][sample] = out[3];
+        }
+    }
+
+    friend SimdVector operator+(SimdVector a, SimdVector b) { return { _mm256_add_pd(a.v, b.v) }; }
+    friend SimdVector operator-(SimdVector a, SimdVector b) { return { _mm256_sub_pd(a.v, b.v) }; }
+    friend SimdVector operator*(SimdVector a, SimdVector b) { return { _mm256_mul_pd(a.v, b.v) }; }
+    friend SimdVector operator/(SimdVector a, SimdVector b) { return { _mm256_div_pd(a.v, b.v) }; }
+};
+#elif FILTERPLUGIN_USE_SSE2
+struct SimdVector
+{
+    static constexpr int size = 2;
+    __m128d v;
+
+    static SimdVector load(const double* p) { return { _mm_loadu_pd(p) }; }
+    static SimdVector broadcast(double x) { return { _mm_set1_pd(x) }; }
+    template <typename SampleType>
+    static SimdVector gather(SampleType* const* channels, int sample)
+    {
+        return { _mm_set_pd(channels[1][sample], channels[0][sample]) };
+    }
+    void store(double* p) const { _mm_storeu_pd(p, v); }
+    template <typename SampleType>
+    void scatter(SampleType* const* channels, int sample) const
+    {
+        channels[0][sample] = static_cast<SampleType>(_mm_cvtsd_f64(v));
+        channels[1][sample] = static_cast<SampleType>(_mm_cvtsd_f64(_mm_unpackhi_pd(v, v)));
+    }
+
+    friend SimdVector operator+(SimdVector a, SimdVector b) { return { _mm_add_pd(a.v, b.v) }; }
+    friend SimdVector operator-(SimdVector a, SimdVector b) { return { _mm_sub_pd(a.v, b.v) }; }
+    friend SimdVector operator*(SimdVector a, SimdVector b) { return { _mm_mul_pd(a.v, b.v) }; }
+    friend SimdVector operator/(SimdVector a, SimdVector b) { return { _mm_div_pd(a.v, b.v) }; }
+};
+#elif FILTERPLUGIN_USE_NEON
+struct SimdVector
+{
+    static constexpr int size = 2;
+    float64x2_t v;
+
+    static SimdVector load(const double* p) { return { vld1q_f64(p) }; }
+    static SimdVector broadcast(double x) { return { vdupq_n_f64(x) }; }
+    template <typename SampleType>
+    static SimdVector gather(SampleType* const* channels, int sample)
+    {
+        return { vsetq_lane_f64(channels[1][sample], vdupq_n_f64(channels[0][sample]), 1) };
+    }
+    void store(double* p) const { vst1q_f64(p, v); }
+    template <typename SampleType>
+    void scatter(SampleType* const* channels, int sample) const
+    {
+        channels[0][sample] = static_cast<SampleType>(vgetq_lane_f64(v, 0));
+        channels[1][sample] = static_cast<SampleType>(vgetq_lane_f64(v, 1));
+    }
+
+    friend SimdVector operator+(SimdVector a, SimdVector b) { return { vaddq_f64(a.v, b.v) }; }
+    friend SimdVector operator-(SimdVector a, SimdVector b) { return { vsubq_f64(a.v, b.v) }; }
+    friend SimdVector operator*(SimdVector a, SimdVector b) { return { vmulq_f64(a.v, b.v) }; }
+    friend SimdVector operator/(SimdVector a, SimdVector b) { return { vdivq_f64(a.v, b.v) }; }
+};
+#else
+using SimdVector = ScalarVector;
+#endif
+
+//==============================================================================
+// Structure-of-arrays view of the five coefficients of a group of channels'
+// sections, in the order of BiquadCoefficients or SvfCoefficients.
+struct CoefficientPointers
+{
+    double* c0;
+    double* c1;
+    double* c2;
+    double* c3;
+    double* c4;
+};
+
+// Runs Vector::size channels through their own sections in place, one sample
+// frame per iteration, using the transposed direct form II.
+template <typename Vector, typename SampleType>
+inline void processBiquadGroup(CoefficientPointers c, double* z1, double* z2,
+                               SampleType* const* channels, int startSample, int numSamples)
+{
+    const Vector b0 = Vector::load(c.c0);
+    const Vector b1 = Vector::load(c.c1);
+    const Vector b2 = Vector::load(c.c2);
+    const Vector a1 = Vector::load(c.c3);
+    const Vector a2 = Vector::load(c.c4);
+    Vector s1 = Vector::load(z1);
+    Vector s2 = Vector::load(z2);
+
+    for (int sample = startSample; sample < startSample + numSamples; ++sample)
+    {
+        const Vector x = Vector::gather(channels, sample);
+        const Vector y = b0 * x + s1;
+        s1 = b1 * x - a1 * y + s2;
+        s2 = b2 * x - a2 * y;
+        y.scatter(channels, sample);
+    }
+
+    s1.store(z1);
+    s2.store(z2);
+}
+
+// processBiquadGroup for sections with b2 = a2 = 0: one state and three taps.
+// Only exact once z2 is zero, which the caller has to make sure of.
+template <typename Vector, typename SampleType>
+inline void processFirstOrderGroup(CoefficientPointers c, double* z1,
+                                   SampleType* const* channels, int startSample, int numSamples)
+{
+    const Vector b0 = Vector::load(c.c0);
+    const Vector b1 = Vector::load(c.c1);
+    const Vector a1 = Vector::load(c.c3);
+    Vector s1 = Vector::load(z1);
+
+    for (int sample = startSample; sample < startSample + numSamples; ++sample)
+    {
+        const Vector x = Vector::gather(channels, sample);
+        const Vector y = b0 * x + s1;
+        s1 = b1 * x - a1 * y;
+        y.scatter(channels, sample);
+    }
+
+    s1.store(z1);
+}
+
+template <typename Vector, typename SampleType>
+inline void processFirstOrderGroupRamp(CoefficientPointers c, CoefficientPointers delta, double* z1,
+                                       SampleType* const* channels, int startSample, int numSamples)
+{
+    Vector b0 = Vector::load(c.c0);
+    Vector b1 = Vector::load(c.c1);
+    Vector a1 = Vector::load(c.c3);
+    const Vector db0 = Vector::load(delta.c0);
+    const Vector db1 = Vector::load(delta.c1);
+    const Vector da1 = Vector::load(delta.c3);
+    Vector s1 = Vector::load(z1);
+
+    for (int sample = startSample; sample < startSample + numSamples; ++sample)
+    {
+        b0 = b0 + db0;
+        b1 = b1 + db1;
+        a1 = a1 + da1;
+
+        const Vector x = Vector::gather(channels, sample);
+        const Vector y = b0 * x + s1;
+        s1 = b1 * x - a1 * y;
+        y.scatter(channels, sample);
+    }
+
+    b0.store(c.c0);
+    b1.store(c.c1);
+    a1.store(c.c3);
+    s1.store(z1);
+}
+
+// Same as processBiquadGroup, but moves every coefficient by its delta after
+// each sample, for linear coefficient interpolation. The advanced
+// coefficients are written back.
+template <typename Vector, typename SampleType>
+inline void processBiquadGroupRamp(CoefficientPointers c, CoefficientPointers delta, double* z1, double* z2,
+                                   SampleType* const* channels, int startSample, int numSamples)
+{
+    Vector b0 = Vector::load(c.c0);
+    Vector b1 = Vector::load(c.c1);
+    Vector b2 = Vector::load(c.c2);
+    Vector a1 = Vector::load(c.c3);
+    Vector a2 = Vector::load(c.c4);
+    const Vector db0 = Vector::load(delta.c0);
+    const Vector db1 = Vector::load(delta.c1);
+    const Vector db2 = Vector::load(delta.c2);
+    const Vector da1 = Vector::load(delta.c3);
+    const Vector da2 = Vector::load(delta.c4);
+    Vector s1 = Vector::load(z1);
+    Vector s2 = Vector::load(z2);
+
+    for (int sample = startSample; sample < startSample + numSamples; ++sample)
+    {
+        b0 = b0 + db0;
+        b1 = b1 + db1;
+        b2 = b2 + db2;
+        a1 = a1 + da1;
+        a2 = a2 + da2;
+
+        const Vector x = Vector::gather(channels, sample);
+        const Vector y = b0 * x + s1;
+        s1 = b1 * x - a1 * y + s2;
+        s2 = b2 * x - a2 * y;
+        y.scatter(channels, sample);
+    }
+
+    b0.store(c.c0);
+    b1.store(c.c1);
+    b2.store(c.c2);
+    a1.store(c.c3);
+    a2.store(c.c4);
+    s1.store(z1);
+    s2.store(z2);
+}
+
+// Runs Vector::size channels through trapezoidal state variable filters in
+// place. z1 and z2 hold the two integrator states. The state stays well
+// scaled at low cutoffs, where the direct form's state grows with 1/g^2.
+template <typename Vector, typename SampleType>
+inline void processSvfGroup(CoefficientPointers c, double* z1, double* z2,
+                            SampleType* const* channels, int startSample, int numSamples)
+{
+    const Vector one = Vector::broadcast(1.0);
+    const Vector two = Vector::broadcast(2.0);
+    const Vector g = Vector::load(c.c0);
+    const Vector k = Vector::load(c.c1);
+    const Vector m0 = Vector::load(c.c2);
+    const Vector m1 = Vector::load(c.c3);
+    const Vector m2 = Vector::load(c.c4);
+    const Vector h1 = one / (one + g * (g + k));
+    const Vector h2 = g * h1;
+    const Vector h3 = g * h2;
+    Vector s1 = Vector::load(z1);
+    Vector s2 = Vector::load(z2);
+
+    for (int sample = startSample; sample < startSample + numSamples; ++sample)
+    {
+        const Vector x = Vector::gather(channels, sample);
+        const Vector v3 = x - s2;
+        const Vector band = h1 * s1 + h2 * v3;
+        const Vector low = s2 + h2 * s1 + h3 * v3;
+        s1 = two * band - s1;
+        s2 = two * low - s2;
+        const Vector y = m0 * x + m1 * band + m2 * low;
+        y.scatter(channels, sample);
+    }
+
+    s1.store(z1);
+    s2.store(z2);
+}
+
+// Same as processSvfGroup, with g, k and the mix interpolated linearly. A
+// state variable filter stays stable for any path through valid g and k, so
+// this is safe even for large jumps.
+template <typename Vector, typename SampleType>
+inline void processSvfGroupRamp(CoefficientPointers c, CoefficientPointers delta, double* z1, double* z2,
+                                SampleType* const* channels, int startSample, int numSamples)
+{
+    const Vector one = Vector::broadcast(1.0);
+    const Vector two = Vector::broadcast(2.0);
+    Vector g = Vector::load(c.c0);
+    Vector k = Vector::load(c.c1);
+    Vector m0 = Vector::load(c.c2);
+    Vector m1 = Vector::load(c.c3);
+    Vector m2 = Vector::load(c.c4);
+    const Vector dg = Vector::load(delta.c0);
+    const Vector dk = Vector::load(delta.c1);
+    const Vector dm0 = Vector::load(delta.c2);
+    const Vector dm1 = Vector::load(delta.c3);
+    const Vector dm2 = Vector::load(delta.c4);
+    Vector s1 = Vector::load(z1);
+    Vector s2 = Vector::load(z2);
+
+    for (int sample = startSample; sample < startSample + numSamples; ++sample)
+    {
+        g = g + dg;
+        k = k + dk;
+        m0 = m0 + dm0;
+        m1 = m1 + dm1;
+        m2 = m2 + dm2;
+
+        const Vector h1 = one / (one + g * (g + k));
+        const Vector h2 = g * h1;
+        const Vector h3 = g * h2;
+
+        const Vector x = Vector::gather(channels, sample);
+        const Vector v3 = x - s2;
+        const Vector band = h1 * s1 + h2 * v3;
+        const Vector low = s2 + h2 * s1 + h3 * v3;
+        s1 = two * band - s1;
+        s2 = two * low - s2;
+        const Vector y = m0 * x + m1 * band + m2 * low;
+        y.scatter(channels, sample);
+    }
+
+    g.store(c.c0);
+    k.store(c.c1);
+    m0.store(c.c2);
+    m1.store(c.c3);
+    m2.store(c.c4);
+    s1.store(z1);
+    s2.store(z2);
+}
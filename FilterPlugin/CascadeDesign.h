@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+#include "BiquadKernels.h"
+
+//==============================================================================
+// Q of every second-order section of a Butterworth or Linkwitz-Riley cascade.
+// Each section is then designed as an ordinary second-order rubdsp filter at
+// the same cutoff, only with its Q taken from here instead of the Q knob.
+enum class CascadeAlignment
+{
+    butterworth = 0,
+    linkwitz_riley
+};
+
+using CascadeQs = std::array<double, MAX_FILTER_SECTIONS>;
+
+// Q of the k-th (zero based) conjugate pole pair of an order N Butterworth
+// filter, i.e. 1 / (2 sin((2k + 1) pi / 2N)).
+inline double butterworthQ(int order, int k)
+{
+    constexpr double pi = 3.14159265358979323846;
+    return 1.0 / (2.0 * std::sin((2 * k + 1) * pi / (2.0 * order)));
+}
+
+// Fills the first numSections Qs for an order 2 * numSections filter.
+inline void designCascade(CascadeAlignment alignment, int numSections, CascadeQs& Qs)
+{
+    const int order = 2 * numSections;
+    if (alignment == CascadeAlignment::butterworth)
+    {
+        for (int k = 0; k < numSections; ++k)
+        {
+            Qs[static_cast<size_t>(k)] = butterworthQ(order, k);
+        }
+        return;
+    }
+
+    // Linkwitz-Riley is a Butterworth filter of half the order squared. With
+    // an odd half order its real pole is squared into one section of Q 0.5.
+    const int half_order = order / 2;
+    int section = 0;
+    if (half_order % 2 == 1)
+    {
+        Qs[static_cast<size_t>(section++)] = 0.5;
+    }
+    for (int k = 0; k < half_order / 2; ++k)
+    {
+        Qs[static_cast<size_t>(section++)] = butterworthQ(half_order, k);
+        Qs[static_cast<size_t>(section++)] = butterworthQ(half_order, k);
+    }
+}
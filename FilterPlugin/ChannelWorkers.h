@@ -0,0 +1,270 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Channel-samples times sections below which a hand-off to the workers
+    // costs more than it saves, so the calling thread does it all itself.
+    constexpr int PARALLEL_MIN_WORK = 32768;
+    constexpr int PARALLEL_MIN_CHANNELS = 8;
+    constexpr int MAX_CHANNEL_WORKERS = 7;
+
+    // How long an idle worker spins for the next block before it parks
+    constexpr double WORKER_SPIN_SECONDS = 0.0005;
+
+    // How long the audio thread spins on tasks a worker has claimed but not
+    // finished before it starts yielding its time slice to that worker
+    constexpr double CALLER_SPIN_SECONDS = 0.00005;
+
+    // Lower half of the claim word while run() rewrites the job's fields:
+    // never below any task count, so nothing can be claimed.
+    constexpr juce::uint32 CLAIM_CLOSED = 0xffffffff;
+
+    inline void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+        _mm_pause();
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+        __asm__ __volatile__("yield");
+#endif
+    }
+}
+
+//==============================================================================
+// A small pool of high priority threads that help the audio thread through
+// independent pieces of one block, such as groups of channels. run() hands
+// out the tasks through one atomic counter, which also carries the job's
+// generation so a late worker can never claim a task of the next job. The
+// counter is closed while the job's fields are rewritten, and a worker checks
+// it again after reading them, so it never runs one job's task with another
+// job's fields. The calling thread claims tasks too, so a worker that hasn't
+// been woken yet simply gets no tasks and a block never waits for a thread to
+// be scheduled. What it does wait for is tasks a worker claimed and is still
+// running. It spins on those for CALLER_SPIN_SECONDS, then yields between
+// checks: if the worker was preempted, possibly onto the audio thread's own
+// core, that is what lets it finish instead of the audio thread spinning out
+// its slice.
+//
+// Between jobs the workers spin for a short while and then park on an event.
+// Waking a parked worker is the only place the audio thread can touch a
+// mutex, inside the event's signal.
+class ChannelWorkers
+{
+public:
+    using Task = void (*)(void* context, int task);
+
+    ~ChannelWorkers()
+    {
+        release();
+    }
+
+    // Message thread, from prepareToPlay. Any previous workers are stopped.
+    void prepare(int numWorkers)
+    {
+        release();
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            _workers.push_back(std::make_unique<Worker>(*this, i));
+        }
+        for (auto& worker : _workers)
+        {
+            // JUCE maps the highest priority to a real-time class where it can
+           #if JUCE_MAJOR_VERSION >= 7
+            worker->startThread(juce::Thread::Priority::highest);
+           #else
+            worker->startThread(10);
+           #endif
+        }
+    }
+
+    void release()
+    {
+        for (auto& worker : _workers)
+        {
+            worker->signalThreadShouldExit();
+            worker->wake();
+        }
+        for (auto& worker : _workers)
+        {
+            worker->stopThread(1000);
+        }
+        _workers.clear();
+    }
+
+    // Tests only, before prepare: called by a worker between seeing a job and
+    // reading its fields, and by run() between writing a job's fields and
+    // opening it, to widen the windows in which a late worker reads a job
+    // that is being replaced.
+    void setJobReadHook(void (*hook)())
+    {
+        _job_read_hook = hook;
+    }
+
+    // Threads a job is spread over, the calling one included.
+    int getNumThreads() const
+    {
+        return static_cast<int>(_workers.size()) + 1;
+    }
+
+    // Audio thread. Calls task(context, i) for every i in [0, numTasks) and
+    // returns once all of them are done.
+    void run(int numTasks, Task task, void* context)
+    {
+        if (_workers.empty() || numTasks <= 1)
+        {
+            for (int i = 0; i < numTasks; ++i)
+                task(context, i);
+            return;
+        }
+
+        // All of the last job's tasks are done, but a late worker may still be
+        // reading its fields. Close its claims before they change, so whatever
+        // mix of old and new fields such a worker reads, it can't claim with it.
+        _claim.store((static_cast<juce::uint64>(_generation) << 32) | CLAIM_CLOSED, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        _task.store(task, std::memory_order_relaxed);
+        _context.store(context, std::memory_order_relaxed);
+        _num_tasks.store(numTasks, std::memory_order_relaxed);
+        _remaining.store(numTasks, std::memory_order_relaxed);
+        const auto generation = ++_generation;
+        if (_job_read_hook != nullptr)
+            _job_read_hook();
+        _claim.store(static_cast<juce::uint64>(generation) << 32, std::memory_order_release);
+
+        for (auto& worker : _workers)
+        {
+            if (worker->isParked())
+                worker->wake();
+        }
+
+        work(generation);
+        if (_remaining.load(std::memory_order_acquire) == 0)
+            return;
+
+        const auto spin_ticks = juce::Time::secondsToHighResolutionTicks(CALLER_SPIN_SECONDS);
+        const auto waiting_since = juce::Time::getHighResolutionTicks();
+        while (_remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (juce::Time::getHighResolutionTicks() - waiting_since < spin_ticks)
+                cpuRelax();
+            else
+                juce::Thread::yield();
+        }
+    }
+
+private:
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(ChannelWorkers& pool, int index)
+            : juce::Thread("Channel worker " + juce::String(index + 1)), _pool(pool)
+        {
+        }
+
+        bool isParked() const
+        {
+            return _parked.load();
+        }
+
+        void wake()
+        {
+            _wake.signal();
+        }
+
+    private:
+        void run() override
+        {
+            const auto spin_ticks = juce::Time::secondsToHighResolutionTicks(WORKER_SPIN_SECONDS);
+            juce::uint32 seen = 0;
+            auto idle_since = juce::Time::getHighResolutionTicks();
+            while (!threadShouldExit())
+            {
+                const auto generation = _pool.getGeneration();
+                if (generation != seen)
+                {
+                    seen = generation;
+                    _pool.work(generation);
+                    idle_since = juce::Time::getHighResolutionTicks();
+                    continue;
+                }
+
+                if (juce::Time::getHighResolutionTicks() - idle_since < spin_ticks)
+                {
+                    cpuRelax();
+                    continue;
+                }
+
+                // Parked has to be visible before the generation is checked
+                // again, so that run() either sees it or this sees the job.
+                _parked.store(true);
+                if (_pool.getGeneration() == seen && !threadShouldExit())
+                {
+                    _wake.wait(100);
+                }
+                _parked.store(false);
+                idle_since = juce::Time::getHighResolutionTicks();
+            }
+        }
+
+        ChannelWorkers& _pool;
+        juce::WaitableEvent _wake;
+        std::atomic<bool> _parked { false };
+    };
+
+    juce::uint32 getGeneration() const
+    {
+        return static_cast<juce::uint32>(_claim.load() >> 32);
+    }
+
+    // Runs tasks of the given job until none are left to claim. The job's
+    // fields are read like a sequence lock: if run() started rewriting them
+    // for a newer job meanwhile, the second look at the claim word sees this
+    // job closed or gone, and none of them are used.
+    void work(juce::uint32 generation)
+    {
+        auto claim = _claim.load(std::memory_order_acquire);
+        if (static_cast<juce::uint32>(claim >> 32) != generation)
+            return;
+
+        if (_job_read_hook != nullptr)
+            _job_read_hook();
+        const auto task = _task.load(std::memory_order_relaxed);
+        auto* context = _context.load(std::memory_order_relaxed);
+        const auto num_tasks = static_cast<juce::uint32>(_num_tasks.load(std::memory_order_relaxed));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        claim = _claim.load(std::memory_order_relaxed);
+        while (static_cast<juce::uint32>(claim >> 32) == generation
+               && static_cast<juce::uint32>(claim & 0xffffffff) < num_tasks)
+        {
+            if (_claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel))
+            {
+                task(context, static_cast<int>(claim & 0xffffffff));
+                _remaining.fetch_sub(1, std::memory_order_release);
+                claim = _claim.load(std::memory_order_acquire);
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+
+    // The job, valid while its generation is in the upper half of _claim.
+    // The lower half is the next task to hand out.
+    std::atomic<Task> _task { nullptr };
+    std::atomic<void*> _context { nullptr };
+    std::atomic<int> _num_tasks { 0 };
+    std::atomic<int> _remaining { 0 };
+    std::atomic<juce::uint64> _claim { 0 };
+    juce::uint32 _generation = 0; // audio thread only
+    void (*_job_read_hook)() = nullptr;
+};
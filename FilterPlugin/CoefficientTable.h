@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "BiquadKernels.h"
+#include "FilterDesigner.h"
+
+namespace
+{
+    constexpr int TABLE_FREQUENCY_POINTS = 128;
+    constexpr double TABLE_FREQUENCY_MIN = 10.0;
+    constexpr double TABLE_FREQUENCY_MAX = 20000.0;
+    constexpr int TABLE_Q_POINTS = 31;
+    constexpr double TABLE_Q_MIN = 0.01;
+    constexpr double TABLE_Q_MAX = 10.0;
+    // Half a step off 0 dB, where the gain types design to a plain wire and
+    // leave nothing to interpolate their poles from
+    constexpr int TABLE_GAIN_POINTS = 22;
+    constexpr double TABLE_GAIN_MIN = -99.0;
+    constexpr double TABLE_GAIN_MAX = 27.0;
+}
+
+//==============================================================================
+// Precomputed coefficients for every rubdsp filter algorithm on a
+// warped log-frequency x log-Q (x gain, for the algorithms that use it) grid, so
+// modulated filters can be retuned with a few multiply-adds instead of a full
+// design.
+//
+// Second-order sections are stored and interpolated as state variable filters,
+// log g and log k for the poles and the output mix linearly, with the band
+// output scaled by k as every filter type's is: any g > 0 and k > 0 is a
+// stable filter, and the mix follows fc, Q and gain far more smoothly than
+// the direct form taps do. First-order algorithms get the same treatment as
+// one-pole filters, log g and the mix of input and low pass.
+class CoefficientTable
+{
+public:
+    // Expensive, SharedDesigns runs it on its own thread. Does nothing if the
+    // table was already built for this sample rate.
+    void build(double sampleRate)
+    {
+        if (sampleRate == _sample_rate)
+            return;
+
+        _sample_rate = sampleRate;
+        _designer.reset(sampleRate);
+
+        _max_frequency = std::min(TABLE_FREQUENCY_MAX, 0.49 * sampleRate);
+        _log_frequency_min = logWarped(TABLE_FREQUENCY_MIN);
+        _log_frequency_step = (logWarped(_max_frequency) - _log_frequency_min) / (TABLE_FREQUENCY_POINTS - 1);
+        _log_Q_min = std::log(TABLE_Q_MIN);
+        _log_Q_step = (std::log(TABLE_Q_MAX) - _log_Q_min) / (TABLE_Q_POINTS - 1);
+        _gain_step = (TABLE_GAIN_MAX - TABLE_GAIN_MIN) / (TABLE_GAIN_POINTS - 1);
+
+        _tables.resize(rubdsp::filterAlgorithm::NUM_ALGROITHMS);
+        for (int algorithm = 0; algorithm < rubdsp::filterAlgorithm::NUM_ALGROITHMS; ++algorithm)
+        {
+            buildAlgorithm(algorithm);
+        }
+    }
+
+    bool isBuiltFor(double sampleRate) const
+    {
+        return !_tables.empty() && sampleRate == _sample_rate;
+    }
+
+    BiquadCoefficients lookup(int algorithm, double fc, double Q, double boost_cut) const
+    {
+        const auto& table = _tables[algorithm];
+
+        int f, q, g;
+        double ft, qt, gt;
+        const double clamped_fc = std::min(std::max(fc, TABLE_FREQUENCY_MIN), _max_frequency);
+        locate((logWarped(clamped_fc) - _log_frequency_min) / _log_frequency_step, TABLE_FREQUENCY_POINTS, f, ft);
+        locate((std::log(std::max(Q, TABLE_Q_MIN)) - _log_Q_min) / _log_Q_step, table.num_Q, q, qt);
+        locate((boost_cut - TABLE_GAIN_MIN) / _gain_step, table.num_gain, g, gt);
+
+        // Gain types mix the filter in proportion to the linear gain, so
+        // place it between its two grid gains by amplitude rather than dB
+        if (gt > 0.0)
+        {
+            const double low = TABLE_GAIN_MIN + g * _gain_step;
+            gt = (std::pow(10.0, (boost_cut - low) / 20.0) - 1.0) / (std::pow(10.0, _gain_step / 20.0) - 1.0);
+        }
+
+        // Both forms are five doubles; the weighted sum is the same either way
+        GridPoint sum { 0.0, 0.0, 0.0, 0.0, 0.0 };
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            const int df = corner & 1, dq = (corner >> 1) & 1, dg = (corner >> 2) & 1;
+            const double weight = (df ? ft : 1.0 - ft) * (dq ? qt : 1.0 - qt) * (dg ? gt : 1.0 - gt);
+            if (weight == 0.0)
+                continue;
+
+            const auto& point = table.at(f + df, q + dq, g + dg);
+            for (size_t i = 0; i < point.size(); ++i)
+            {
+                sum[i] += weight * point[i];
+            }
+        }
+
+        if (table.first_order)
+        {
+            // One-pole low pass g / (1 + g) (1 + z^-1) / (1 + a1 z^-1), mixed with the input
+            const double g = std::exp(sum[0]);
+            const double low = sum[3] * g / (1.0 + g);
+            const double a1 = (g - 1.0) / (g + 1.0);
+            return { sum[2] + low, sum[2] * a1 + low, 0.0, a1, 0.0 };
+        }
+        const double k = std::exp(sum[1]);
+        return fromSvf({ std::exp(sum[0]), k, sum[2], sum[3] * k, sum[4] });
+    }
+
+private:
+    // log g, log k, m0, m1 / k, m2; first-order algorithms only use log g,
+    // the input mix m0 and the low pass mix in the m1 slot
+    using GridPoint = std::array<double, 5>;
+
+    struct AlgorithmTable
+    {
+        int num_Q = 1;
+        int num_gain = 1;
+        bool first_order = true;
+        std::vector<GridPoint> points;
+
+        const GridPoint& at(int f, int q, int g) const
+        {
+            f = std::min(f, TABLE_FREQUENCY_POINTS - 1);
+            q = std::min(q, num_Q - 1);
+            g = std::min(g, num_gain - 1);
+            return points[static_cast<size_t>((g * num_Q + q) * TABLE_FREQUENCY_POINTS + f)];
+        }
+    };
+
+    // Splits a continuous grid position into a cell index and the fraction
+    // within it, clamped to the grid.
+    static void locate(double position, int size, int& index, double& fraction)
+    {
+        if (size <= 1 || position <= 0.0)
+        {
+            index = 0;
+            fraction = 0.0;
+            return;
+        }
+        if (position >= size - 1)
+        {
+            index = size - 1;
+            fraction = 0.0;
+            return;
+        }
+        index = static_cast<int>(position);
+        fraction = position - index;
+    }
+
+    static constexpr double PI = 3.141592653589793238463;
+
+    // Frequencies are spaced evenly in log g = log tan(w / 2), the bilinear
+    // transform's prewarped frequency, so the pole moves linearly along the
+    // grid all the way up to Nyquist.
+    double logWarped(double frequency) const
+    {
+        return std::log(std::tan(PI * frequency / _sample_rate));
+    }
+
+    BiquadCoefficients design(int algorithm, double fc, double Q, double boost_cut)
+    {
+        auto parameters = _designer.getParameters();
+        parameters.algorithm = static_cast<rubdsp::filterAlgorithm>(algorithm);
+        parameters.fc = fc;
+        parameters.Q = Q;
+        parameters.boost_cut_db = boost_cut;
+        return _designer.design(parameters);
+    }
+
+    void buildAlgorithm(int algorithm)
+    {
+        auto& table = _tables[algorithm];
+
+        // Only grid the dimensions the algorithm actually responds to
+        const bool uses_Q = _designer.usesQ(algorithm);
+        const bool uses_gain = _designer.usesGain(algorithm);
+        table.num_Q = uses_Q ? TABLE_Q_POINTS : 1;
+        table.num_gain = uses_gain ? TABLE_GAIN_POINTS : 1;
+        const size_t num_points = static_cast<size_t>(TABLE_FREQUENCY_POINTS * table.num_Q * table.num_gain);
+
+        std::vector<BiquadCoefficients> designs(num_points);
+        for (int g = 0; g < table.num_gain; ++g)
+        {
+            const double boost_cut = uses_gain ? TABLE_GAIN_MIN + g * _gain_step : 0.0;
+            for (int q = 0; q < table.num_Q; ++q)
+            {
+                const double Q = uses_Q ? std::exp(_log_Q_min + q * _log_Q_step) : 1.0;
+                for (int f = 0; f < TABLE_FREQUENCY_POINTS; ++f)
+                {
+                    const double fc = std::atan(std::exp(_log_frequency_min + f * _log_frequency_step)) * _sample_rate / PI;
+                    designs[static_cast<size_t>((g * table.num_Q + q) * TABLE_FREQUENCY_POINTS + f)]
+                        = design(algorithm, fc, Q, boost_cut);
+                }
+            }
+        }
+
+        table.first_order = std::all_of(designs.begin(), designs.end(),
+                                        [](const BiquadCoefficients& c) { return c.a2 == 0.0; });
+        table.points.resize(num_points);
+        for (size_t i = 0; i < num_points; ++i)
+        {
+            const auto& c = designs[i];
+            if (table.first_order)
+            {
+                const double g = (1.0 + c.a1) / (1.0 - c.a1);
+                const double nyquist = (c.b0 - c.b1) / (1.0 - c.a1);
+                const double dc = (c.b0 + c.b1) / (1.0 + c.a1);
+                table.points[i] = { std::log(g), 0.0, nyquist, dc - nyquist, 0.0 };
+            }
+            else
+            {
+                const auto svf = toSvf(c);
+                table.points[i] = { std::log(svf.g), std::log(svf.k), svf.m0, svf.m1 / svf.k, svf.m2 };
+            }
+        }
+    }
+
+    FilterDesigner _designer;
+    std::vector<AlgorithmTable> _tables;
+    double _sample_rate = 0.0;
+    double _max_frequency = TABLE_FREQUENCY_MAX;
+    double _log_frequency_min = 0.0;
+    double _log_frequency_step = 1.0;
+    double _log_Q_min = 0.0;
+    double _log_Q_step = 1.0;
+    double _gain_step = 1.0;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr float ENVELOPE_FLOOR_DB = -120.0f;
+}
+
+// Indices match DETECTOR_NAMES
+enum class EnvelopeDetector
+{
+    peak = 0,
+    rms
+};
+
+//==============================================================================
+// Level detector for the dynamic filter modes. All channels are linked: peak
+// follows the loudest channel, RMS the mean square across channels. A one-pole
+// smoother with separate attack and release times runs at the host rate and
+// writes its state for every sample, so the caller can read the level at any
+// point of the block. Audio thread only, after prepare.
+class EnvelopeFollower
+{
+public:
+    // Message thread, from prepareToPlay.
+    void prepare(double sampleRate)
+    {
+        _sample_rate = sampleRate;
+        _attack_ms = -1.0f;
+        _release_ms = -1.0f;
+        reset();
+    }
+
+    void reset()
+    {
+        _envelope = 0.0f;
+    }
+
+    // Cheap to call every block; the coefficients are only recomputed when
+    // a time changes.
+    void setTimes(float attackMs, float releaseMs)
+    {
+        if (attackMs != _attack_ms)
+        {
+            _attack_ms = attackMs;
+            _attack = coefficient(attackMs);
+        }
+        if (releaseMs != _release_ms)
+        {
+            _release_ms = releaseMs;
+            _release = coefficient(releaseMs);
+        }
+    }
+
+    void setDetector(EnvelopeDetector detector)
+    {
+        if (detector != _detector)
+        {
+            // Peak holds magnitudes and RMS squares, so the state doesn't carry over
+            _detector = detector;
+            reset();
+        }
+    }
+
+    // Writes the envelope after each of the numSamples samples from startSample
+    // to levels[0..numSamples).
+    template <typename SampleType>
+    void process(const SampleType* const* channels, int numChannels, int startSample, int numSamples, float* levels)
+    {
+        if (numChannels <= 0)
+        {
+            std::fill(levels, levels + numSamples, _envelope);
+            return;
+        }
+
+        const float channel_gain = 1.0f / numChannels;
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float input = 0.0f;
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const auto sample = static_cast<float>(channels[channel][startSample + i]);
+                input = _detector == EnvelopeDetector::peak ? std::max(input, std::abs(sample))
+                                                            : input + sample * sample * channel_gain;
+            }
+
+            const float coefficient = input > _envelope ? _attack : _release;
+            _envelope = input + coefficient * (_envelope - input);
+            levels[i] = _envelope;
+        }
+    }
+
+    // Converts a value written by process to dB.
+    float toDecibels(float level) const
+    {
+        const float scale = _detector == EnvelopeDetector::peak ? 20.0f : 10.0f;
+        return level > 0.0f ? std::max(ENVELOPE_FLOOR_DB, scale * std::log10(level)) : ENVELOPE_FLOOR_DB;
+    }
+
+private:
+    // Time to cover 1 - 1/e of a step
+    float coefficient(float timeMs) const
+    {
+        const double samples = std::max(1.0, 0.001 * timeMs * _sample_rate);
+        return static_cast<float>(std::exp(-1.0 / samples));
+    }
+
+    double _sample_rate = 44100.0;
+    EnvelopeDetector _detector = EnvelopeDetector::peak;
+    float _attack_ms = -1.0f;
+    float _release_ms = -1.0f;
+    float _attack = 0.0f;
+    float _release = 0.0f;
+    float _envelope = 0.0f;
+};
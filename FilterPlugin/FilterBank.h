@@ -0,0 +1,480 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <vector>
+
+#include "BiquadKernels.h"
+#include "ChannelWorkers.h"
+
+// A bypassed section only stops running once its state has decayed below this
+constexpr double BYPASS_STATE_THRESHOLD = 1e-12;
+
+//==============================================================================
+// A cascade of up to maxSections second-order sections per channel, for any
+// number of channels. The coefficients and state of all channels are kept
+// structure-of-arrays, section after section, so a group of adjacent channels
+// maps directly onto one SIMD register and a whole cascade is run over a
+// chunk while it is still in cache. Sections can be switched out of the
+// cascade individually, and then cost nothing.
+//
+// Sections are always specified as biquads. With the state variable topology
+// they are converted on the way in and run as trapezoidal SVFs, which keep
+// their precision for very low cutoffs and high Q where the direct form's
+// coefficients crowd towards the unit circle. Both float and double buffers
+// can be processed; the filter itself always runs in double.
+//
+// Each section is classified when its coefficients are set (see
+// SectionKernel), and every process call picks the matching kernel for each
+// section from a dispatch table once. The inner loops then have no branches
+// and no taps that are always zero: a first-order section runs three taps
+// and one state, and in direct form a section that is an identity, such as a
+// peak or shelf at 0 dB, doesn't run at all.
+//
+// Channels never depend on each other, so given a ChannelWorkers pool a
+// large enough call is split into runs of whole SIMD groups, one per thread.
+class FilterBank
+{
+public:
+    // Allocates storage, call from prepareToPlay only.
+    void prepare(int numChannels, int maxSections = 1)
+    {
+        _num_channels = numChannels;
+        _stride = ((numChannels + SimdVector::size - 1) / SimdVector::size) * SimdVector::size;
+        _max_sections = std::max(maxSections, 1);
+        auto size = static_cast<size_t>(_stride * _max_sections);
+        _coefficients.assign(size);
+        _deltas.assign(size);
+        _targets.assign(size);
+        _z1.assign(size, 0.0);
+        _z2.assign(size, 0.0);
+        _ramp_remaining = 0;
+        _kernels.assign(static_cast<size_t>(_max_sections), SectionKernel::bypass);
+        _target_kernels.assign(static_cast<size_t>(_max_sections), SectionKernel::bypass);
+        _block_kernels.assign(static_cast<size_t>(_max_sections), SectionKernel::bypass);
+        for (int section = 0; section < _max_sections; ++section)
+        {
+            setCoefficients(section, BiquadCoefficients());
+        }
+
+        _section_active.assign(static_cast<size_t>(_max_sections), false);
+        _active_sections.assign(static_cast<size_t>(_max_sections), 0);
+        _num_active_sections = 0;
+        setSectionActive(0, true);
+    }
+
+    void reset()
+    {
+        std::fill(_z1.begin(), _z1.end(), 0.0);
+        std::fill(_z2.begin(), _z2.end(), 0.0);
+    }
+
+    int getNumChannels() const
+    {
+        return _num_channels;
+    }
+
+    // Switches every section to the given structure. The state of the two
+    // topologies means different things, so this resets the filter and
+    // leaves all sections as pass-throughs for the caller to set again.
+    void setTopology(FilterTopology topology)
+    {
+        _topology = topology;
+        _ramp_remaining = 0;
+        _deltas.clear();
+        for (int section = 0; section < _max_sections; ++section)
+        {
+            setCoefficients(section, BiquadCoefficients());
+        }
+        reset();
+    }
+
+    FilterTopology getTopology() const
+    {
+        return _topology;
+    }
+
+    // Number of sections currently in the cascade.
+    int getNumSections() const
+    {
+        return _num_active_sections;
+    }
+
+    // Makes the first numSections sections the cascade.
+    void setNumSections(int numSections)
+    {
+        numSections = std::min(std::max(numSections, 1), _max_sections);
+        for (int section = 0; section < _max_sections; ++section)
+        {
+            setSectionActive(section, section < numSections);
+        }
+    }
+
+    // Switches one section in or out of the cascade without allocating. The
+    // other sections keep their state. A section that comes into use starts
+    // out as a clean pass-through, so ramping it to its design fades it in.
+    void setSectionActive(int section, bool active)
+    {
+        if (_section_active[static_cast<size_t>(section)] == active)
+            return;
+
+        if (active)
+        {
+            for (int channel = 0; channel < _num_channels; ++channel)
+            {
+                const int index = section * _stride + channel;
+                const auto pass_through = pack(BiquadCoefficients(), SectionKernel::bypass);
+                _coefficients.set(index, pass_through);
+                _targets.set(index, pass_through);
+                _deltas.set(index, { 0.0, 0.0, 0.0, 0.0, 0.0 });
+                _z1[static_cast<size_t>(index)] = 0.0;
+                _z2[static_cast<size_t>(index)] = 0.0;
+            }
+            _kernels[static_cast<size_t>(section)] = SectionKernel::bypass;
+            _target_kernels[static_cast<size_t>(section)] = SectionKernel::bypass;
+        }
+        _section_active[static_cast<size_t>(section)] = active;
+
+        _num_active_sections = 0;
+        for (int i = 0; i < _max_sections; ++i)
+        {
+            if (_section_active[static_cast<size_t>(i)])
+            {
+                _active_sections[static_cast<size_t>(_num_active_sections++)] = i;
+            }
+        }
+    }
+
+    bool isSectionActive(int section) const
+    {
+        return _section_active[static_cast<size_t>(section)];
+    }
+
+    // Jumps straight to new coefficients. A running ramp is cut short, with
+    // every other section landing on its target.
+    void setCoefficients(const BiquadCoefficients& c)
+    {
+        setCoefficients(0, c);
+    }
+
+    void setCoefficients(int section, const BiquadCoefficients& c)
+    {
+        if (_ramp_remaining > 0)
+        {
+            _coefficients = _targets;
+            _kernels = _target_kernels;
+            _deltas.clear();
+            _ramp_remaining = 0;
+        }
+
+        const auto kernel = classifySection(c, _topology);
+        const auto packed = pack(c, kernel);
+        for (int channel = 0; channel < _num_channels; ++channel)
+        {
+            _coefficients.set(section * _stride + channel, packed);
+            _targets.set(section * _stride + channel, packed);
+        }
+        _kernels[static_cast<size_t>(section)] = kernel;
+        _target_kernels[static_cast<size_t>(section)] = kernel;
+    }
+
+    // Linearly interpolates every channel from its current coefficients to c
+    // over the next numSamples processed samples. All sections share the ramp
+    // length, so ramp every section of a cascade with the same numSamples.
+    void rampCoefficients(const BiquadCoefficients& c, int numSamples)
+    {
+        rampCoefficients(0, c, numSamples);
+    }
+
+    void rampCoefficients(int section, const BiquadCoefficients& c, int numSamples)
+    {
+        if (numSamples <= 0)
+        {
+            setCoefficients(section, c);
+            return;
+        }
+
+        // Until the ramp ends the section needs a kernel that can run both
+        // where it is, which may be part way through an earlier ramp, and
+        // where it is going.
+        const auto kernel = classifySection(c, _topology);
+        _kernels[static_cast<size_t>(section)] = std::max(_kernels[static_cast<size_t>(section)],
+                                                         _target_kernels[static_cast<size_t>(section)]);
+        _target_kernels[static_cast<size_t>(section)] = kernel;
+
+        const double scale = 1.0 / numSamples;
+        const auto target = pack(c, kernel);
+        for (int channel = 0; channel < _num_channels; ++channel)
+        {
+            const int index = section * _stride + channel;
+            _targets.set(index, target);
+            _deltas.c0[index] = (target.c0 - _coefficients.c0[index]) * scale;
+            _deltas.c1[index] = (target.c1 - _coefficients.c1[index]) * scale;
+            _deltas.c2[index] = (target.c2 - _coefficients.c2[index]) * scale;
+            _deltas.c3[index] = (target.c3 - _coefficients.c3[index]) * scale;
+            _deltas.c4[index] = (target.c4 - _coefficients.c4[index]) * scale;
+        }
+        _ramp_remaining = numSamples;
+    }
+
+    // Filters the first min(numChannels, getNumChannels()) channels in place,
+    // spread over the workers if there are any and the call is worth it.
+    template <typename SampleType>
+    void process(SampleType* const* channels, int numChannels, int startSample, int numSamples,
+                 ChannelWorkers* workers = nullptr)
+    {
+        numChannels = std::min(numChannels, _num_channels);
+
+        if (_ramp_remaining > 0)
+        {
+            const int ramp_samples = std::min(numSamples, _ramp_remaining);
+            selectKernels(true);
+            runGroups<true>(channels, numChannels, startSample, ramp_samples, workers);
+            startSample += ramp_samples;
+            numSamples -= ramp_samples;
+            _ramp_remaining -= ramp_samples;
+
+            if (_ramp_remaining == 0)
+            {
+                // Land exactly on the target instead of the accumulated ramp,
+                // and stop sections that aren't part of the next ramp moving.
+                _coefficients = _targets;
+                _kernels = _target_kernels;
+                _deltas.clear();
+            }
+        }
+
+        if (numSamples > 0)
+        {
+            selectKernels(false);
+            runGroups<false>(channels, numChannels, startSample, numSamples, workers);
+        }
+    }
+
+    template <typename SampleType>
+    void process(SampleType* const* channels, int numChannels, int numSamples)
+    {
+        process(channels, numChannels, 0, numSamples);
+    }
+
+private:
+    // The five coefficients of one section in the current topology's order,
+    // see CoefficientPointers.
+    struct PackedCoefficients
+    {
+        double c0, c1, c2, c3, c4;
+    };
+
+    // First-order sections get an exact zero for b2, so that the second-order
+    // kernel leaves z2 at exactly zero too.
+    PackedCoefficients pack(const BiquadCoefficients& c, SectionKernel kernel) const
+    {
+        if (_topology == FilterTopology::state_variable)
+        {
+            const auto svf = toSvf(c);
+            return { svf.g, svf.k, svf.m0, svf.m1, svf.m2 };
+        }
+        return { c.b0, c.b1, kernel == SectionKernel::first_order ? 0.0 : c.b2, c.a1, c.a2 };
+    }
+
+    struct CoefficientArrays
+    {
+        std::vector<double> c0, c1, c2, c3, c4;
+
+        void assign(size_t size)
+        {
+            for (auto* array : { &c0, &c1, &c2, &c3, &c4 })
+            {
+                array->assign(size, 0.0);
+            }
+        }
+
+        void clear()
+        {
+            for (auto* array : { &c0, &c1, &c2, &c3, &c4 })
+            {
+                std::fill(array->begin(), array->end(), 0.0);
+            }
+        }
+
+        void set(int index, const PackedCoefficients& c)
+        {
+            c0[index] = c.c0;
+            c1[index] = c.c1;
+            c2[index] = c.c2;
+            c3[index] = c.c3;
+            c4[index] = c.c4;
+        }
+
+        CoefficientPointers at(int index)
+        {
+            return { &c0[index], &c1[index], &c2[index], &c3[index], &c4[index] };
+        }
+    };
+
+    // Picks the kernel of every active section for the coming samples. The
+    // cheaper kernels are only exact from a clean state: a bypassed section
+    // keeps running until what it still rings with is negligible, and a
+    // first-order one runs as a biquad until its second state is zero.
+    void selectKernels(bool ramp)
+    {
+        const auto full = _topology == FilterTopology::state_variable ? SectionKernel::state_variable
+                                                                      : SectionKernel::second_order;
+        for (int i = 0; i < _num_active_sections; ++i)
+        {
+            const int section = _active_sections[static_cast<size_t>(i)];
+            auto kernel = _kernels[static_cast<size_t>(section)];
+            if (ramp)
+            {
+                kernel = std::max(kernel, _target_kernels[static_cast<size_t>(section)]);
+            }
+
+            const auto first = _z1.begin() + section * _stride;
+            const auto second = _z2.begin() + section * _stride;
+            if (kernel == SectionKernel::bypass)
+            {
+                const auto settled = [](double z) { return std::abs(z) <= BYPASS_STATE_THRESHOLD; };
+                if (std::all_of(first, first + _num_channels, settled) && std::all_of(second, second + _num_channels, settled))
+                {
+                    std::fill(first, first + _num_channels, 0.0);
+                    std::fill(second, second + _num_channels, 0.0);
+                }
+                else
+                {
+                    kernel = full;
+                }
+            }
+            else if (kernel == SectionKernel::first_order
+                     && !std::all_of(second, second + _num_channels, [](double z) { return z == 0.0; }))
+            {
+                kernel = SectionKernel::second_order;
+            }
+            _block_kernels[static_cast<size_t>(i)] = kernel;
+        }
+    }
+
+    template <typename SampleType>
+    using GroupKernel = void (*)(CoefficientPointers, CoefficientPointers, double*, double*, SampleType* const*, int, int);
+
+    template <typename Vector, bool ramp, SectionKernel kernel, typename SampleType>
+    static void runKernel(CoefficientPointers c, CoefficientPointers delta, double* z1, double* z2,
+                          SampleType* const* channels, int startSample, int numSamples)
+    {
+        if constexpr (kernel == SectionKernel::first_order && ramp)
+            processFirstOrderGroupRamp<Vector>(c, delta, z1, channels, startSample, numSamples);
+        else if constexpr (kernel == SectionKernel::first_order)
+            processFirstOrderGroup<Vector>(c, z1, channels, startSample, numSamples);
+        else if constexpr (kernel == SectionKernel::second_order && ramp)
+            processBiquadGroupRamp<Vector>(c, delta, z1, z2, channels, startSample, numSamples);
+        else if constexpr (kernel == SectionKernel::second_order)
+            processBiquadGroup<Vector>(c, z1, z2, channels, startSample, numSamples);
+        else if constexpr (ramp)
+            processSvfGroupRamp<Vector>(c, delta, z1, z2, channels, startSample, numSamples);
+        else
+            processSvfGroup<Vector>(c, z1, z2, channels, startSample, numSamples);
+    }
+
+    // Indexed by SectionKernel; bypassed sections never get here.
+    template <typename Vector, bool ramp, typename SampleType>
+    static GroupKernel<SampleType> getKernel(SectionKernel kernel)
+    {
+        static constexpr GroupKernel<SampleType> table[] = {
+            nullptr,
+            &runKernel<Vector, ramp, SectionKernel::first_order, SampleType>,
+            &runKernel<Vector, ramp, SectionKernel::second_order, SampleType>,
+            &runKernel<Vector, ramp, SectionKernel::state_variable, SampleType>
+        };
+        static_assert(std::size(table) == static_cast<size_t>(SectionKernel::num_kernels), "one kernel per SectionKernel");
+        return table[static_cast<size_t>(kernel)];
+    }
+
+    template <typename SampleType>
+    struct GroupTask
+    {
+        FilterBank* bank;
+        SampleType* const* channels;
+        int num_channels;
+        int channels_per_task;
+        int start_sample;
+        int num_samples;
+
+        template <bool ramp>
+        static void run(void* context, int task)
+        {
+            const auto& t = *static_cast<GroupTask*>(context);
+            const int first = task * t.channels_per_task;
+            t.bank->template processGroups<ramp>(t.channels, first, std::min(first + t.channels_per_task, t.num_channels),
+                                                 t.start_sample, t.num_samples);
+        }
+    };
+
+    // Every task gets whole SIMD groups, and the last one the scalar rest, so
+    // no two threads write the same coefficients or state.
+    template <bool ramp, typename SampleType>
+    void runGroups(SampleType* const* channels, int numChannels, int startSample, int numSamples, ChannelWorkers* workers)
+    {
+        if (workers != nullptr && numChannels * numSamples * _num_active_sections >= PARALLEL_MIN_WORK)
+        {
+            const int num_groups = (numChannels + SimdVector::size - 1) / SimdVector::size;
+            const int num_tasks = std::min(num_groups, workers->getNumThreads());
+            if (num_tasks > 1)
+            {
+                const int channels_per_task = ((num_groups + num_tasks - 1) / num_tasks) * SimdVector::size;
+                GroupTask<SampleType> task { this, channels, numChannels, channels_per_task, startSample, numSamples };
+                workers->run((numChannels + channels_per_task - 1) / channels_per_task,
+                             &GroupTask<SampleType>::template run<ramp>, &task);
+                return;
+            }
+        }
+        processGroups<ramp>(channels, 0, numChannels, startSample, numSamples);
+    }
+
+    template <bool ramp, typename SampleType>
+    void processGroups(SampleType* const* channels, int firstChannel, int endChannel, int startSample, int numSamples)
+    {
+        int channel = firstChannel;
+        for (; channel + SimdVector::size <= endChannel; channel += SimdVector::size)
+        {
+            processGroup<SimdVector, ramp>(channels, channel, startSample, numSamples);
+        }
+        for (; channel < endChannel; ++channel)
+        {
+            processGroup<ScalarVector, ramp>(channels, channel, startSample, numSamples);
+        }
+    }
+
+    template <typename Vector, bool ramp, typename SampleType>
+    void processGroup(SampleType* const* channels, int first, int startSample, int numSamples)
+    {
+        for (int i = 0; i < _num_active_sections; ++i)
+        {
+            const auto kernel = _block_kernels[static_cast<size_t>(i)];
+            if (kernel == SectionKernel::bypass)
+                continue;
+
+            const int index = _active_sections[static_cast<size_t>(i)] * _stride + first;
+            getKernel<Vector, ramp, SampleType>(kernel)(_coefficients.at(index), _deltas.at(index), &_z1[index], &_z2[index],
+                                                        channels + first, startSample, numSamples);
+        }
+    }
+
+    FilterTopology _topology = FilterTopology::transposed_direct_form_2;
+    int _num_channels = 0;
+    int _stride = 0;
+    int _max_sections = 1;
+    std::vector<bool> _section_active;
+    std::vector<int> _active_sections;
+    int _num_active_sections = 0;
+    CoefficientArrays _coefficients;
+    CoefficientArrays _deltas;
+    CoefficientArrays _targets;
+    std::vector<double> _z1, _z2;
+    int _ramp_remaining = 0;
+
+    // Per section, for the current coefficients and the ramp targets, and per
+    // active section for the samples being processed.
+    std::vector<SectionKernel> _kernels;
+    std::vector<SectionKernel> _target_kernels;
+    std::vector<SectionKernel> _block_kernels;
+};
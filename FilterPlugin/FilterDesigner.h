@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "audio_filter.h"
+#include "BiquadKernels.h"
+
+using FilterParameters = std::decay_t<decltype(std::declval<rubdsp::AudioFilter&>().getParameters())>;
+
+namespace
+{
+    constexpr int DESIGN_PROBE_LENGTH = 32;
+    constexpr double DESIGN_DIFFERS_TOLERANCE = 1e-9;
+}
+
+//==============================================================================
+// Turns rubdsp::AudioFilter parameters into plain direct form coefficients so
+// the block kernels can run them. rubdsp stays the only place that knows the
+// filter designs: every algorithm it offers is a second-order section with an
+// optional dry/wet mix, so the coefficients are recovered exactly from the
+// first few samples of its impulse response. Which parameters an algorithm
+// responds to is found the same way, by designing it twice.
+class FilterDesigner
+{
+public:
+    void reset(double sampleRate)
+    {
+        _sample_rate = sampleRate;
+        probeAlgorithms();
+        _filter.reset(_sample_rate);
+    }
+
+    // Whether an algorithm's design depends on Q / on boost_cut at all.
+    bool usesQ(int algorithm) const
+    {
+        return _uses_Q[static_cast<size_t>(algorithm)];
+    }
+
+    bool usesGain(int algorithm) const
+    {
+        return _uses_gain[static_cast<size_t>(algorithm)];
+    }
+
+    FilterParameters getParameters()
+    {
+        return _filter.getParameters();
+    }
+
+    BiquadCoefficients design(const FilterParameters& parameters)
+    {
+        _filter.setParameters(parameters);
+        return fitImpulseResponse();
+    }
+
+private:
+    using Response = std::array<double, DESIGN_PROBE_LENGTH>;
+
+    // Designs every algorithm with the Q and then the gain far apart, and
+    // puts the parameters back as they were.
+    void probeAlgorithms()
+    {
+        const auto parameters = _filter.getParameters();
+        for (int algorithm = 0; algorithm < rubdsp::filterAlgorithm::NUM_ALGROITHMS; ++algorithm)
+        {
+            auto probe = [&](double Q, double boost_cut)
+            {
+                auto probed = parameters;
+                probed.algorithm = static_cast<rubdsp::filterAlgorithm>(algorithm);
+                probed.fc = 1000.0;
+                probed.Q = Q;
+                probed.boost_cut_db = boost_cut;
+                return design(probed);
+            };
+            _uses_Q[static_cast<size_t>(algorithm)] = differs(probe(0.5, 6.0), probe(4.0, 6.0));
+            _uses_gain[static_cast<size_t>(algorithm)] = differs(probe(1.0, -12.0), probe(1.0, 12.0));
+        }
+        _filter.setParameters(parameters);
+    }
+
+    static bool differs(const BiquadCoefficients& a, const BiquadCoefficients& b)
+    {
+        return std::abs(a.b0 - b.b0) > DESIGN_DIFFERS_TOLERANCE || std::abs(a.b1 - b.b1) > DESIGN_DIFFERS_TOLERANCE
+            || std::abs(a.b2 - b.b2) > DESIGN_DIFFERS_TOLERANCE || std::abs(a.a1 - b.a1) > DESIGN_DIFFERS_TOLERANCE
+            || std::abs(a.a2 - b.a2) > DESIGN_DIFFERS_TOLERANCE;
+    }
+
+    // The denominator is solved in delta form around z = s (s = +1 for poles
+    // near DC, -1 for poles near Nyquist). Fitting the small offsets on the
+    // differenced response keeps low cutoffs at high sample rates well
+    // conditioned, where the raw impulse response is almost a straight line,
+    // and the second-order fit goes through a QR factorisation rather than
+    // the normal equations, which would square what conditioning is left.
+    //
+    // Both orders are fitted and replayed over the probe. The first-order fit
+    // wins unless the second-order one reproduces the probe better than
+    // rounding alone can explain, so no tolerance has to be tuned per
+    // algorithm or sample rate.
+    BiquadCoefficients fitImpulseResponse()
+    {
+        _filter.reset(_sample_rate);
+
+        Response h;
+        h[0] = _filter.processAudioSample(1.0);
+        for (int n = 1; n < DESIGN_PROBE_LENGTH; ++n)
+        {
+            h[n] = _filter.processAudioSample(0.0);
+        }
+
+        double correlation = 0.0;
+        for (int n = 2; n < DESIGN_PROBE_LENGTH; ++n)
+        {
+            correlation += h[n] * h[n - 1];
+        }
+        const double s = correlation >= 0.0 ? 1.0 : -1.0;
+
+        // f[n] = h[n] - s h[n-1], g[n] = h[n] - 2s h[n-1] + h[n-2]
+        Response f, g;
+        f[0] = h[0];
+        g[0] = h[0];
+        g[1] = h[1] - 2.0 * s * h[0];
+        for (int n = 1; n < DESIGN_PROBE_LENGTH; ++n)
+        {
+            f[n] = h[n] - s * h[n - 1];
+        }
+        for (int n = 2; n < DESIGN_PROBE_LENGTH; ++n)
+        {
+            g[n] = f[n] - s * f[n - 1];
+        }
+
+        // First order: f[n] + w h[n-1] = 0 for n >= 2, with a1 = w - s
+        double hh = 0.0, fh = 0.0;
+        for (int n = 2; n < DESIGN_PROBE_LENGTH; ++n)
+        {
+            hh += h[n - 1] * h[n - 1];
+            fh += f[n] * h[n - 1];
+        }
+        if (hh == 0.0)
+            return withNumerator(h, 0.0, 0.0); // FIR, nothing to fit
+
+        const auto first_order = withNumerator(h, -fh / hh - s, 0.0);
+
+        // Second order: g[n] + u f[n-1] + v h[n-2] = 0 for n >= 3, with
+        // a1 = u - 2s and a2 = v - 1 - s a1. Modified Gram-Schmidt on the two
+        // columns, each orthogonalised twice.
+        constexpr int rows = DESIGN_PROBE_LENGTH - 3;
+        std::array<double, rows> q1, q2, rhs;
+        for (int i = 0; i < rows; ++i)
+        {
+            q1[i] = f[i + 2];
+            q2[i] = h[i + 1];
+            rhs[i] = -g[i + 3];
+        }
+
+        const double r11 = normalise(q1);
+        double r12 = 0.0;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            const double projection = dot(q1, q2);
+            r12 += projection;
+            for (int i = 0; i < rows; ++i)
+                q2[i] -= projection * q1[i];
+        }
+        const double r22 = normalise(q2);
+        if (r11 == 0.0 || r22 == 0.0)
+            return first_order;
+
+        const double t1 = dot(q1, rhs);
+        for (int i = 0; i < rows; ++i)
+            rhs[i] -= t1 * q1[i];
+        const double t2 = dot(q2, rhs);
+
+        const double v = t2 / r22;
+        const double u = (t1 - r12 * v) / r11;
+        const double a1 = u - 2.0 * s;
+        const auto second_order = withNumerator(h, a1, v - 1.0 - s * a1);
+
+        // An exact fit can't get closer than the rounding in the probe itself
+        double peak = 0.0;
+        for (auto sample : h)
+            peak = std::max(peak, std::abs(sample));
+        const double rounding = DESIGN_PROBE_LENGTH * std::numeric_limits<double>::epsilon() * peak;
+
+        const double first_error = replayError(first_order, h);
+        const double second_error = replayError(second_order, h);
+        return first_error <= std::max(second_error, rounding) ? first_order : second_order;
+    }
+
+    // The numerator follows from the first three samples once the poles are known
+    static BiquadCoefficients withNumerator(const Response& h, double a1, double a2)
+    {
+        BiquadCoefficients c;
+        c.a1 = a1;
+        c.a2 = a2;
+        c.b0 = h[0];
+        c.b1 = h[1] + a1 * h[0];
+        c.b2 = h[2] + a1 * h[1] + a2 * h[0];
+        return c;
+    }
+
+    // Largest difference between the section's impulse response and the probe.
+    static double replayError(const BiquadCoefficients& c, const Response& h)
+    {
+        double x = 1.0, z1 = 0.0, z2 = 0.0, error = 0.0;
+        for (int n = 0; n < DESIGN_PROBE_LENGTH; ++n)
+        {
+            const double y = c.b0 * x + z1;
+            z1 = c.b1 * x - c.a1 * y + z2;
+            z2 = c.b2 * x - c.a2 * y;
+            x = 0.0;
+            error = std::max(error, std::abs(y - h[n]));
+        }
+        return error;
+    }
+
+    template <size_t Size>
+    static double dot(const std::array<double, Size>& a, const std::array<double, Size>& b)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < Size; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    // Scales to unit length and returns the length it had.
+    template <size_t Size>
+    static double normalise(std::array<double, Size>& a)
+    {
+        const double length = std::sqrt(dot(a, a));
+        if (length > 0.0)
+        {
+            for (auto& value : a)
+                value /= length;
+        }
+        return length;
+    }
+
+    rubdsp::AudioFilter _filter;
+    double _sample_rate = 44100.0;
+    std::array<bool, rubdsp::filterAlgorithm::NUM_ALGROITHMS> _uses_Q {};
+    std::array<bool, rubdsp::filterAlgorithm::NUM_ALGROITHMS> _uses_gain {};
+};
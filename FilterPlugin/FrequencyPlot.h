@@ -1,89 +1,534 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 
-#include "PluginProcessor.h"
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "FrequencyResponse.h"
+#include "SpectrumAnalyzer.h"
 #include "utils.h"
 
 namespace
 {
-    constexpr int NUM_GRAPH_POINTS = 512;
+    // The curves get one point per physical pixel of width, within these bounds
+    constexpr int MIN_GRAPH_POINTS = 64;
+    constexpr int MAX_GRAPH_POINTS = 4096;
     constexpr float FREQ_PLOT_MAX = 20000.0f;
     constexpr float FREQ_PLOT_MIN = 10.0f;
-    const float PLOT_STEP = (std::log10(FREQ_PLOT_MAX) - std::log10(FREQ_PLOT_MIN)) / (NUM_GRAPH_POINTS); 
+    constexpr float RESPONSE_PLOT_MIN = -12.0f;
+    constexpr float RESPONSE_PLOT_MAX = 12.0f;
+    constexpr float SPECTRUM_PLOT_MIN = -96.0f;
+    constexpr float SPECTRUM_PLOT_MAX = 0.0f;
+    // The optional overlays span the full height on scales of their own
+    constexpr float PHASE_PLOT_MIN = -180.0f;
+    constexpr float PHASE_PLOT_MAX = 180.0f;
+    constexpr float GROUP_DELAY_PLOT_MIN = 0.0f;
+    constexpr float GROUP_DELAY_PLOT_MAX = 10.0f; // ms
+
+    constexpr std::array<float, 9> GRID_FREQUENCIES { 20.0f, 50.0f, 100.0f, 200.0f, 500.0f, 1000.0f, 2000.0f, 5000.0f, 10000.0f };
+    constexpr std::array<float, 7> GRID_GAINS { -12.0f, -8.0f, -4.0f, 0.0f, 4.0f, 8.0f, 12.0f };
+
+    // One plot never refreshes faster than this, whatever the display rate,
+    // and all the plots in the process together share the second budget.
+    constexpr double PLOT_MAX_FPS = 60.0;
+    constexpr double PLOT_MAX_REFRESHES_PER_SECOND = 240.0;
 }
+
+// JUCE 7 can call back on the display's vertical blank; older versions fall
+// back to a timer at PLOT_MAX_FPS.
+#if JUCE_MAJOR_VERSION >= 7
+    #define FREQUENCY_PLOT_VBLANK 1
+#else
+    #define FREQUENCY_PLOT_VBLANK 0
+#endif
+
 //==============================================================================
+// Caps the repaint work of all the plots in the process, so a session with
+// many editors open can't take over the message thread. Every showing plot
+// gets an equal share of PLOT_MAX_REFRESHES_PER_SECOND. Message thread only.
+class PlotRefreshBudget
+{
+public:
+    void setShowing(bool showing)
+    {
+        _num_showing += showing ? 1 : -1;
+    }
+
+    // Shortest time between two refreshes of one plot.
+    double getIntervalMs() const
+    {
+        return 1000.0 * std::max(1.0 / PLOT_MAX_FPS, _num_showing / PLOT_MAX_REFRESHES_PER_SECOND);
+    }
+
+private:
+    int _num_showing = 0;
+};
+
+//==============================================================================
+// The log-frequency axis of the plots and its e^{-jwk} terms per sample rate,
+// shared by every open editor through a juce::SharedResourcePointer so that
+// plots of the same width don't each compute their own. Message thread only.
+class SharedResponseAxes
+{
+public:
+    std::shared_ptr<const std::vector<float>> getFrequencies(int numPoints)
+    {
+        auto& frequencies = _frequencies[numPoints];
+        if (frequencies == nullptr)
+        {
+            auto points = std::make_shared<std::vector<float>>(static_cast<size_t>(numPoints));
+            const float step = (std::log10(FREQ_PLOT_MAX) - std::log10(FREQ_PLOT_MIN)) / (numPoints - 1);
+            for (int i = 0; i < numPoints; ++i)
+            {
+                (*points)[static_cast<size_t>(i)] = std::pow(10.0f, i * step + std::log10(FREQ_PLOT_MIN));
+            }
+            frequencies = std::move(points);
+        }
+        auto result = frequencies;
+        prune(_frequencies);
+        return result;
+    }
+
+    std::shared_ptr<const std::vector<ResponseTerms>> getTerms(int numPoints, double sampleRate)
+    {
+        auto& terms = _terms[{ numPoints, sampleRate }];
+        if (terms == nullptr)
+        {
+            auto frequencies = getFrequencies(numPoints);
+            auto points = std::make_shared<std::vector<ResponseTerms>>(frequencies->size());
+            for (size_t i = 0; i < frequencies->size(); ++i)
+            {
+                (*points)[i] = ResponseTerms::at((*frequencies)[i], sampleRate);
+            }
+            terms = std::move(points);
+        }
+        auto result = terms;
+        prune(_terms);
+        return result;
+    }
+
+private:
+    // Forgets the axes no plot uses any more, e.g. the sizes passed through
+    // while an editor was being resized.
+    template <typename Map>
+    static void prune(Map& map)
+    {
+        for (auto it = map.begin(); it != map.end();)
+        {
+            if (it->second.use_count() == 1)
+                it = map.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::map<int, std::shared_ptr<const std::vector<float>>> _frequencies;
+    std::map<std::pair<int, double>, std::shared_ptr<const std::vector<ResponseTerms>>> _terms;
+};
+
+//==============================================================================
+// Response curve and spectrum of any processor that publishes a response
+// snapshot (getResponseVersion/getResponseSnapshot) and owns a
+// SpectrumAnalyzer (getAnalyzer), e.g. the filter and the multiband EQ.
+// Phase and group delay can be switched on as overlays; all three curves
+// come out of one evaluateResponse pass.
+//
+// Refreshes are driven by the display (see FREQUENCY_PLOT_VBLANK) and only
+// happen while the plot is showing and something changed, within the shared
+// PlotRefreshBudget. The analyzer only runs while the plot is showing.
+template <typename ProcessorType>
 class FrequencyPlot  : public juce::Component, public juce::Timer
 {
 public:
-    FrequencyPlot (FilterPluginAudioProcessor& p) : processorRef(p)
+    FrequencyPlot (ProcessorType& p) : processorRef(p)
     {
-        _x_points[0] = FREQ_PLOT_MIN;
-        for (int i = 1; i < NUM_GRAPH_POINTS; ++i)
+        // The grid image covers every pixel
+        setOpaque(true);
+
+        for (auto* frame : { &_input_frame, &_output_frame })
+        {
+            frame->average.fill(ANALYZER_MIN_DB);
+            frame->peak.fill(ANALYZER_MIN_DB);
+        }
+
+        _phase_button.setColour(juce::ToggleButton::textColourId, juce::Colours::orange);
+        _delay_button.setColour(juce::ToggleButton::textColourId, juce::Colours::limegreen);
+        for (auto* button : { &_phase_button, &_delay_button })
         {
-            _x_points[i] = std::pow(10.0f, i * PLOT_STEP + std::log10(FREQ_PLOT_MIN));
+            button->onClick = [this] {
+                if (updateResponse())
+                    updatePath();
+                repaint();
+            };
+            addAndMakeVisible(button);
         }
 
-        startTimerHz(30);
+#if !FREQUENCY_PLOT_VBLANK
+        startTimerHz(juce::roundToInt(PLOT_MAX_FPS));
+#endif
     }
     ~FrequencyPlot() override
     {
+        if (_showing)
+        {
+            _budget->setShowing(false);
+            processorRef.getAnalyzer().setActive(false);
+        }
     }
 
     //==============================================================================
+    // Only the curves are drawn here; everything static comes from _grid_image.
     void paint (juce::Graphics& g) override
     {
-        g.fillAll (juce::Colours::black);
+        if (_grid_image.isValid())
+        {
+            g.drawImageTransformed(_grid_image, juce::AffineTransform::scale(1.0f / _grid_scale));
+        }
+        else
+        {
+            g.fillAll(juce::Colours::black);
+        }
+
+        g.setColour(juce::Colours::grey.withAlpha(0.6f));
+        g.strokePath(_input_spectrum_path, juce::PathStrokeType(1.0f));
+        g.setColour(juce::Colours::white.withAlpha(0.25f));
+        g.fillPath(_output_spectrum_path);
+        g.setColour(juce::Colours::white.withAlpha(0.6f));
+        g.strokePath(_output_peak_path, juce::PathStrokeType(1.0f));
+
+        g.setColour(juce::Colours::royalblue);
+        g.strokePath(_path, juce::PathStrokeType(3.0f));
+        g.setColour(juce::Colours::royalblue.withAlpha(0.5f));
+        g.fillPath(_path);
+
+        g.setColour(juce::Colours::orange);
+        g.strokePath(_phase_path, juce::PathStrokeType(1.5f));
+        g.setColour(juce::Colours::limegreen);
+        g.strokePath(_delay_path, juce::PathStrokeType(1.5f));
+    }
+    void resized() override
+    {
+        _grid_scale = juce::jmax(1.0f, juce::Component::getApproximateScaleFactorForComponent(this));
+        renderGrid();
+
+        auto buttons = getLocalBounds().removeFromTop(20).removeFromRight(260);
+        _delay_button.setBounds(buttons.removeFromRight(150));
+        _phase_button.setBounds(buttons);
+
+        auto num_points = juce::jlimit(MIN_GRAPH_POINTS, MAX_GRAPH_POINTS, juce::roundToInt(getWidth() * _grid_scale));
+        if (_x_points == nullptr || num_points != static_cast<int>(_x_points->size()))
+        {
+            setNumPoints(num_points);
+        }
+        updatePath();
+        updateSpectrumPaths();
+    }
+
+    void visibilityChanged() override
+    {
+        updateShowing();
+    }
+
+    void parentHierarchyChanged() override
+    {
+        updateShowing();
+    }
+
+    void timerCallback() override
+    {
+        refresh();
+    }
+
+private:
+    // Minimised or hidden editors stop the analyzer and drop out of the
+    // budget. isShowing() can't see a window covered by another one, so
+    // those still refresh, at their share of the budget.
+    void updateShowing()
+    {
+        const bool showing = isShowing();
+        if (showing == _showing)
+            return;
+
+        _showing = showing;
+        _budget->setShowing(showing);
+        processorRef.getAnalyzer().setActive(showing);
+    }
+
+    // Once per display frame (or timer tick).
+    void refresh()
+    {
+        updateShowing();
+        if (!_showing)
+            return;
+
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        if (now - _last_refresh_ms < _budget->getIntervalMs())
+            return;
+
+        auto& analyzer = processorRef.getAnalyzer();
+        const auto frame_version = analyzer.getFrameVersion();
+        const bool new_frame = frame_version != _frame_version;
+        const bool new_response = processorRef.getResponseVersion() != _version;
+        if (!new_frame && !new_response)
+            return;
 
-        for (int i = 0; i < NUM_GRAPH_POINTS; ++i)
+        bool changed = false;
+        if (new_frame)
         {
-            _y_points[i] = processorRef.getMagnitudedB(_x_points[i]);
-        }  
+            _frame_version = frame_version;
+            analyzer.getFrame(SpectrumAnalyzer::input, _input_frame);
+            analyzer.getFrame(SpectrumAnalyzer::output, _output_frame);
+            updateSpectrumPaths();
+            changed = true;
+        }
+        if (new_response && updateResponse())
+        {
+            updatePath();
+            changed = true;
+        }
+        if (!changed)
+            return;
+
+        _last_refresh_ms = now;
+        repaint();
+    }
+
+    // Message thread, on resize only, so the audio side never sees this.
+    void setNumPoints(int numPoints)
+    {
+        _x_points = _axes->getFrequencies(numPoints);
+        _y_points.assign(static_cast<size_t>(numPoints), 0.0f);
+        _phase_points.assign(static_cast<size_t>(numPoints), 0.0f);
+        _delay_points.assign(static_cast<size_t>(numPoints), 0.0f);
 
+        // New frequencies need new terms and magnitudes
+        _sample_rate = 0.0;
+        updateResponse();
+    }
+
+    // Returns false if the processor hasn't published a response yet. The
+    // version is taken either way, so an unpublished one isn't retried on
+    // every frame.
+    bool updateResponse()
+    {
+        _version = processorRef.getResponseVersion();
+        auto snapshot = processorRef.getResponseSnapshot();
+        auto sample_rate = snapshot.sample_rate;
+        if (sample_rate <= 0.0 || _x_points == nullptr)
+            return false;
+
+        // The e^{-jwk} terms only change with the sample rate
+        if (sample_rate != _sample_rate || _terms == nullptr)
+        {
+            _sample_rate = sample_rate;
+            _terms = _axes->getTerms(static_cast<int>(_x_points->size()), _sample_rate);
+        }
+
+        evaluateResponse(snapshot, _terms->data(), _terms->size(),
+                         { _y_points.data(),
+                           _phase_button.getToggleState() ? _phase_points.data() : nullptr,
+                           _delay_button.getToggleState() ? _delay_points.data() : nullptr });
+        return true;
+    }
+
+    float frequencyToX(float frequency) const
+    {
+        return getWidth() * std::log(frequency / FREQ_PLOT_MIN) / std::log(FREQ_PLOT_MAX / FREQ_PLOT_MIN);
+    }
+
+    float pointToX(size_t index) const
+    {
+        return index * static_cast<float>(getWidth()) / (_y_points.size() - 1);
+    }
+
+    // Background, grid and labels, at the display's pixel density so the
+    // text stays sharp. Redrawn only when the size changes.
+    void renderGrid()
+    {
+        const int width = getWidth();
+        const int height = getHeight();
+        if (width <= 0 || height <= 0)
+        {
+            _grid_image = {};
+            return;
+        }
+
+        _grid_image = juce::Image(juce::Image::RGB,
+                                  juce::roundToInt(width * _grid_scale),
+                                  juce::roundToInt(height * _grid_scale),
+                                  false);
+        juce::Graphics g(_grid_image);
+        g.addTransform(juce::AffineTransform::scale(_grid_scale));
+        g.fillAll(juce::Colours::black);
+        g.setFont(11.0f);
+
+        for (auto frequency : GRID_FREQUENCIES)
+        {
+            const float x = frequencyToX(frequency);
+            g.setColour(juce::Colours::white.withAlpha(0.12f));
+            g.drawVerticalLine(juce::roundToInt(x), 0.0f, static_cast<float>(height));
+
+            const auto label = frequency >= 1000.0f ? juce::String(juce::roundToInt(frequency / 1000.0f)) + "k"
+                                                : juce::String(juce::roundToInt(frequency));
+            g.setColour(juce::Colours::white.withAlpha(0.4f));
+            g.drawText(label, juce::roundToInt(x) + 2, height - 14, 40, 12, juce::Justification::centredLeft, false);
+        }
+
+        for (auto gain : GRID_GAINS)
+        {
+            const float y = rubdsp::map_value(RESPONSE_PLOT_MIN, RESPONSE_PLOT_MAX, static_cast<float>(height), 0.0f, gain, true);
+            g.setColour(juce::Colours::white.withAlpha(gain == 0.0f ? 0.3f : 0.12f));
+            g.drawHorizontalLine(juce::roundToInt(y), 0.0f, static_cast<float>(width));
+
+            const auto label = (gain > 0.0f ? "+" : "") + juce::String(juce::roundToInt(gain)) + " dB";
+            g.setColour(juce::Colours::white.withAlpha(0.4f));
+            g.drawText(label, 2, juce::roundToInt(y) - 12, 48, 12, juce::Justification::centredLeft, false);
+        }
+    }
+
+    void updatePath()
+    {
         float height = getHeight();
         float width = getWidth();
 
-        juce::Path path;
-
-        path.startNewSubPath(0.0f, height + 1.0f);
-        for (int i = 0; i < NUM_GRAPH_POINTS; ++i)
+        _path.clear();
+        _path.startNewSubPath(0.0f, height + 1.0f);
+        for (size_t i = 0; i < _y_points.size(); ++i)
         {
-            float y_value = rubdsp::map_value(-12.0f, 12.0f, height, 0.0f, _y_points[i], true);
-            float x_value = i * width / (NUM_GRAPH_POINTS - 1);//rubdsp::map_value(0.0f, FREQ_PLOT_MAX, 0.0f, width, _x_points[i]);
+            float y_value = rubdsp::map_value(RESPONSE_PLOT_MIN, RESPONSE_PLOT_MAX, height, 0.0f, _y_points[i], true);
+            float x_value = pointToX(i);
             if (isnan(y_value))
             {
                 y_value = 0.0f;
             }
-            path.lineTo(x_value, y_value);
-            // g.setColour(juce::Colours::orangered);
-            // g.fillEllipse(x_value - 5.0f, y_value - 5.0f, 10.0f, 10.0f);
+            _path.lineTo(x_value, y_value);
         }
-        path.lineTo(width, height + 1.0f);
-        path.closeSubPath();
+        _path.lineTo(width, height + 1.0f);
+        _path.closeSubPath();
 
-        g.setColour(juce::Colours::royalblue);
-        g.strokePath(path, juce::PathStrokeType(3.0f));
-        g.setColour(juce::Colours::royalblue.withAlpha(0.5f));
-        g.fillPath(path);     
+        updateOverlayPath(_phase_path, _phase_points, _phase_button.getToggleState(), PHASE_PLOT_MIN, PHASE_PLOT_MAX, true);
+        updateOverlayPath(_delay_path, _delay_points, _delay_button.getToggleState(), GROUP_DELAY_PLOT_MIN, GROUP_DELAY_PLOT_MAX, false);
     }
-    void resized() override
+
+    // An open line; a wrapping curve (the phase) is broken where it jumps by
+    // a full turn.
+    void updateOverlayPath(juce::Path& path, const std::vector<float>& points, bool visible, float minimum, float maximum, bool wraps)
     {
+        float height = getHeight();
+
+        path.clear();
+        if (!visible)
+            return;
 
+        const float wrap = 0.5f * (maximum - minimum);
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            float y_value = rubdsp::map_value(minimum, maximum, height, 0.0f, points[i], true);
+            float x_value = pointToX(i);
+            if (isnan(y_value))
+            {
+                y_value = height;
+            }
+            if (i == 0 || (wraps && std::abs(points[i] - points[i - 1]) > wrap))
+            {
+                path.startNewSubPath(x_value, y_value);
+            }
+            else
+            {
+                path.lineTo(x_value, y_value);
+            }
+        }
     }
 
-    void timerCallback() override
+    void updateSpectrumPaths()
     {
-        repaint();
+        auto sample_rate = processorRef.getAnalyzer().getSampleRate();
+        updateSpectrumPath(_input_spectrum_path, _input_frame.average, sample_rate, false);
+        updateSpectrumPath(_output_spectrum_path, _output_frame.average, sample_rate, true);
+        updateSpectrumPath(_output_peak_path, _output_frame.peak, sample_rate, false);
+    }
+
+    void updateSpectrumPath(juce::Path& path, const std::array<float, ANALYZER_NUM_BINS>& levels, double sampleRate, bool closed)
+    {
+        float height = getHeight();
+        float width = getWidth();
+
+        path.clear();
+        if (_x_points == nullptr)
+            return;
+
+        if (closed)
+        {
+            path.startNewSubPath(0.0f, height + 1.0f);
+        }
+        const auto& x_points = *_x_points;
+        for (size_t i = 0; i < x_points.size(); ++i)
+        {
+            // Linear interpolation between the two FFT bins around the plot frequency
+            float bin = static_cast<float>(x_points[i] * ANALYZER_FFT_SIZE / sampleRate);
+            int index = juce::jlimit(0, ANALYZER_NUM_BINS - 2, static_cast<int>(bin));
+            float fraction = juce::jlimit(0.0f, 1.0f, bin - index);
+            float level = levels[index] + fraction * (levels[index + 1] - levels[index]);
+
+            float y_value = rubdsp::map_value(SPECTRUM_PLOT_MIN, SPECTRUM_PLOT_MAX, height, 0.0f, level, true);
+            float x_value = pointToX(i);
+            if (i == 0 && !closed)
+            {
+                path.startNewSubPath(x_value, y_value);
+            }
+            else
+            {
+                path.lineTo(x_value, y_value);
+            }
+        }
+        if (closed)
+        {
+            path.lineTo(width, height + 1.0f);
+            path.closeSubPath();
+        }
     }
 
-private:
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
-    FilterPluginAudioProcessor& processorRef;
+    ProcessorType& processorRef;
+
+    juce::SharedResourcePointer<SharedResponseAxes> _axes;
+    juce::SharedResourcePointer<PlotRefreshBudget> _budget;
+    bool _showing = false;
+    double _last_refresh_ms = 0.0;
+    std::shared_ptr<const std::vector<float>> _x_points;
+    std::vector<float> _y_points;
+    std::vector<float> _phase_points;
+    std::vector<float> _delay_points;
+    std::shared_ptr<const std::vector<ResponseTerms>> _terms;
+    double _sample_rate = 0.0;
+    unsigned int _version = 0;
+    juce::Path _path;
+    juce::Path _phase_path;
+    juce::Path _delay_path;
+    juce::ToggleButton _phase_button { "Phase (+/-180 deg)" };
+    juce::ToggleButton _delay_button { "Group delay (0-10 ms)" };
+
+    juce::Image _grid_image;
+    float _grid_scale = 1.0f;
+
+    unsigned int _frame_version = 0;
+    SpectrumAnalyzer::Frame _input_frame;
+    SpectrumAnalyzer::Frame _output_frame;
+    juce::Path _input_spectrum_path;
+    juce::Path _output_spectrum_path;
+    juce::Path _output_peak_path;
 
-    std::array<float, NUM_GRAPH_POINTS> _x_points;
-    std::array<float, NUM_GRAPH_POINTS> _y_points;
+#if FREQUENCY_PLOT_VBLANK
+    // Declared last so it detaches before anything refresh() uses goes away
+    juce::VBlankAttachment _vblank { this, [this] { refresh(); } };
+#endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FrequencyPlot)
 };
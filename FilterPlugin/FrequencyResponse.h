@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "BiquadKernels.h"
+
+namespace
+{
+    // Points evaluateResponse works on at once, sized so the per-point
+    // accumulators stay in registers while it walks the sections.
+    constexpr size_t RESPONSE_BATCH = 8;
+}
+
+//==============================================================================
+// The e^{-jwk} terms (k = 1, 2) of a biquad transfer function at one
+// frequency. They only depend on the frequency and the sample rate, so callers
+// evaluating the same frequencies repeatedly should keep them around.
+struct ResponseTerms
+{
+    double cos1 = 1.0;
+    double sin1 = 0.0;
+    double cos2 = 1.0;
+    double sin2 = 0.0;
+
+    static ResponseTerms at(double frequency, double sampleRate)
+    {
+        constexpr double two_pi = 6.283185307179586476925;
+        const double w = two_pi * frequency / sampleRate;
+        return { std::cos(w), std::sin(w), std::cos(2.0 * w), std::sin(2.0 * w) };
+    }
+};
+
+// What the editor needs to draw the filter: the sections the audio thread
+// last installed and the sample rate they were designed for.
+template <size_t MaxSections>
+struct BasicResponseSnapshot
+{
+    std::array<BiquadCoefficients, MaxSections> sections;
+    int num_sections = 1;
+    double sample_rate = 0.0;
+};
+
+using ResponseSnapshot = BasicResponseSnapshot<MAX_FILTER_SECTIONS>;
+
+inline double magnitudedB(const BiquadCoefficients& c, const ResponseTerms& t)
+{
+    const double num_re = c.b0 + c.b1 * t.cos1 + c.b2 * t.cos2;
+    const double num_im = -(c.b1 * t.sin1 + c.b2 * t.sin2);
+    const double den_re = 1.0 + c.a1 * t.cos1 + c.a2 * t.cos2;
+    const double den_im = -(c.a1 * t.sin1 + c.a2 * t.sin2);
+    return 10.0 * std::log10((num_re * num_re + num_im * num_im) / (den_re * den_re + den_im * den_im));
+}
+
+// Radius of a section's largest pole. The impulse response decays like
+// radius^n, so 1 or more means it never dies out.
+inline double poleRadius(const BiquadCoefficients& c)
+{
+    const double discriminant = c.a1 * c.a1 - 4.0 * c.a2;
+    if (discriminant < 0.0)
+        return std::sqrt(c.a2); // complex pair, |p|^2 == a2
+
+    const double root = std::sqrt(discriminant);
+    return 0.5 * std::max(std::abs(-c.a1 + root), std::abs(-c.a1 - root));
+}
+
+// Cascaded sections multiply, so their responses add up in dB.
+template <size_t MaxSections>
+double magnitudedB(const BasicResponseSnapshot<MaxSections>& snapshot, const ResponseTerms& t)
+{
+    double magnitude = 0.0;
+    for (int section = 0; section < snapshot.num_sections; ++section)
+    {
+        magnitude += magnitudedB(snapshot.sections[static_cast<size_t>(section)], t);
+    }
+    return magnitude;
+}
+
+// Where evaluateResponse writes its results, one value per point. Any of the
+// curves can be left null to skip it.
+struct ResponseCurves
+{
+    float* magnitude_db = nullptr;
+    float* phase_degrees = nullptr; // wrapped to [-180, 180]
+    float* group_delay_ms = nullptr;
+
+    // The same curves from point index on.
+    ResponseCurves from(size_t index) const
+    {
+        return { magnitude_db != nullptr ? magnitude_db + index : nullptr,
+                 phase_degrees != nullptr ? phase_degrees + index : nullptr,
+                 group_delay_ms != nullptr ? group_delay_ms + index : nullptr };
+    }
+};
+
+// Magnitude, phase and group delay of the whole cascade at numPoints
+// frequencies in one pass. Each section's numerator N and denominator D are
+// evaluated once per point from the shared terms and feed all three curves:
+// the powers |N|^2 and |D|^2 multiply up for the magnitude, N * conj(D) for
+// the phase, and the group delay of a polynomial P(z) = sum p_k z^-k is
+// Re{sum k p_k e^{-jwk} / P}, so the sections' delays add up as N's minus
+// D's. The log and atan2 are then only taken once per point instead of once
+// per section. The inner loops run across a batch of points so they
+// vectorise.
+template <size_t MaxSections>
+void evaluateResponse(const BasicResponseSnapshot<MaxSections>& snapshot, const ResponseTerms* terms,
+                      size_t numPoints, const ResponseCurves& curves)
+{
+    constexpr double radians_to_degrees = 57.29577951308232;
+    constexpr double min_power = 1e-30; // at an exact zero the delay is undefined
+    const double ms_per_sample = snapshot.sample_rate > 0.0 ? 1000.0 / snapshot.sample_rate : 0.0;
+
+    for (size_t start = 0; start < numPoints; start += RESPONSE_BATCH)
+    {
+        const size_t count = std::min(RESPONSE_BATCH, numPoints - start);
+        const auto* t = terms + start;
+
+        std::array<double, RESPONSE_BATCH> num_power, den_power, re, im, delay;
+        num_power.fill(1.0);
+        den_power.fill(1.0);
+        re.fill(1.0);
+        im.fill(0.0);
+        delay.fill(0.0);
+
+        for (int section = 0; section < snapshot.num_sections; ++section)
+        {
+            const auto& c = snapshot.sections[static_cast<size_t>(section)];
+            for (size_t i = 0; i < count; ++i)
+            {
+                const double num_re = c.b0 + c.b1 * t[i].cos1 + c.b2 * t[i].cos2;
+                const double num_im = -(c.b1 * t[i].sin1 + c.b2 * t[i].sin2);
+                const double den_re = 1.0 + c.a1 * t[i].cos1 + c.a2 * t[i].cos2;
+                const double den_im = -(c.a1 * t[i].sin1 + c.a2 * t[i].sin2);
+
+                const double num_k_re = c.b1 * t[i].cos1 + 2.0 * c.b2 * t[i].cos2;
+                const double num_k_im = -(c.b1 * t[i].sin1 + 2.0 * c.b2 * t[i].sin2);
+                const double den_k_re = c.a1 * t[i].cos1 + 2.0 * c.a2 * t[i].cos2;
+                const double den_k_im = -(c.a1 * t[i].sin1 + 2.0 * c.a2 * t[i].sin2);
+
+                const double np = num_re * num_re + num_im * num_im;
+                const double dp = den_re * den_re + den_im * den_im;
+                num_power[i] *= np;
+                den_power[i] *= dp;
+
+                const double h_re = num_re * den_re + num_im * den_im;
+                const double h_im = num_im * den_re - num_re * den_im;
+                const double next_re = re[i] * h_re - im[i] * h_im;
+                im[i] = re[i] * h_im + im[i] * h_re;
+                re[i] = next_re;
+
+                const double num_delay = np > min_power ? (num_k_re * num_re + num_k_im * num_im) / np : 0.0;
+                const double den_delay = (den_k_re * den_re + den_k_im * den_im) / dp;
+                delay[i] += num_delay - den_delay;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (curves.magnitude_db != nullptr)
+                curves.magnitude_db[start + i] = static_cast<float>(10.0 * std::log10(num_power[i] / den_power[i]));
+            if (curves.phase_degrees != nullptr)
+                curves.phase_degrees[start + i] = static_cast<float>(radians_to_degrees * std::atan2(im[i], re[i]));
+            if (curves.group_delay_ms != nullptr)
+                curves.group_delay_ms[start + i] = static_cast<float>(delay[i] * ms_per_sample);
+        }
+    }
+}
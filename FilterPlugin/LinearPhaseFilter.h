@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include <juce_dsp/juce_dsp.h>
+
+#include "FrequencyResponse.h"
+#include "SeqLock.h"
+
+//==============================================================================
+// Linear-phase version of whatever response the audio thread publishes.
+// juce::dsp::Convolution runs a symmetric FIR kernel made from the magnitude
+// of the latest ResponseSnapshot with uniformly partitioned FFT convolution.
+// The kernel delays everything by half its length.
+//
+// loadKernel designs the first kernel of a length on the message thread and
+// puts it in place at once, so there is never a moment where audio passes
+// unfiltered or the reported latency isn't that of the kernel running. From
+// then on a background thread redesigns the kernel, at the same length,
+// whenever the response changes, and the convolution crossfades between
+// kernels that have the same delay. The thread only runs while a kernel is
+// loaded, i.e. in linear phase mode.
+//
+// A Convolution only processes up to two channels, so wider buses get one per
+// channel pair, all loading the same kernel through one shared queue.
+class LinearPhaseFilter : private juce::Thread
+{
+public:
+    explicit LinearPhaseFilter(const SeqLock<ResponseSnapshot>& response)
+        : juce::Thread("Linear phase kernel designer"), _response(response)
+    {
+    }
+
+    ~LinearPhaseFilter() override
+    {
+        stopThread(1000);
+    }
+
+    // Message thread, from prepareToPlay. Unloads the kernel, until the next
+    // loadKernel the convolutions must not run.
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        stopThread(1000);
+        _spec = spec;
+        _sample_rate = spec.sampleRate;
+
+        const auto num_pairs = std::max<size_t>(1, (spec.numChannels + 1) / 2);
+        _convolutions.resize(num_pairs);
+        for (auto& convolution : _convolutions)
+        {
+            if (convolution == nullptr)
+                convolution = std::make_unique<juce::dsp::Convolution>(juce::dsp::Convolution::Latency { 0 }, _queue);
+        }
+        prepareConvolutions();
+        _kernel_length = 0;
+    }
+
+    // Message thread, with the audio thread held off. Designs a kernel of the
+    // given length, a power of two, from the latest published response and
+    // makes it the one that runs straight away, without a crossfade from the
+    // last one, whose delay may differ. Then starts the designer thread.
+    void loadKernel(int length)
+    {
+        stopThread(1000);
+
+        const auto version = _response.getVersion();
+        load(design(_response.load(), length));
+
+        // Preparing applies whatever was loaded last right away and drops the
+        // kernel that was running, rather than fading between the two
+        prepareConvolutions();
+        _kernel_length = length;
+        _designed_version = version;
+        startThread();
+    }
+
+    // Message thread. Stops the designer thread, the kernel stays loaded.
+    void release()
+    {
+        stopThread(1000);
+    }
+
+    // Of the kernel that is loaded
+    int getLatencySamples() const
+    {
+        // Every pair runs the same partitioning, so the same latency
+        return _kernel_length / 2 + (_convolutions.empty() ? 0 : _convolutions.front()->getLatency());
+    }
+
+    void reset()
+    {
+        for (auto& convolution : _convolutions)
+        {
+            convolution->reset();
+        }
+    }
+
+    // Audio thread.
+    void process(juce::dsp::AudioBlock<float>& block)
+    {
+        const auto num_channels = block.getNumChannels();
+        for (size_t pair = 0; pair < _convolutions.size() && 2 * pair < num_channels; ++pair)
+        {
+            auto channels = block.getSubsetChannelBlock(2 * pair, std::min<size_t>(2, num_channels - 2 * pair));
+            juce::dsp::ProcessContextReplacing<float> context(channels);
+            _convolutions[pair]->process(context);
+        }
+    }
+
+private:
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            auto version = _response.getVersion();
+            if (version != _designed_version)
+            {
+                _designed_version = version;
+                load(design(_response.load(), _kernel_length));
+            }
+            wait(20);
+        }
+    }
+
+    void prepareConvolutions()
+    {
+        for (size_t pair = 0; pair < _convolutions.size(); ++pair)
+        {
+            const auto num_channels = std::min<juce::uint32>(2, _spec.numChannels - static_cast<juce::uint32>(2 * pair));
+            _convolutions[pair]->prepare({ _spec.sampleRate, _spec.maximumBlockSize, std::max<juce::uint32>(num_channels, 1) });
+        }
+    }
+
+    // Queues the kernel for every pair; the convolutions pick it up and
+    // crossfade to it on their own
+    void load(juce::AudioBuffer<float> impulse)
+    {
+        for (size_t pair = 0; pair < _convolutions.size(); ++pair)
+        {
+            auto kernel_copy = pair + 1 < _convolutions.size() ? impulse : std::move(impulse);
+            _convolutions[pair]->loadImpulseResponse(std::move(kernel_copy), _sample_rate,
+                                                     juce::dsp::Convolution::Stereo::no,
+                                                     juce::dsp::Convolution::Trim::no,
+                                                     juce::dsp::Convolution::Normalise::no);
+        }
+    }
+
+    // A plain delay by length / 2 if nothing was published yet, which can't
+    // happen once the processor has been prepared.
+    juce::AudioBuffer<float> design(const ResponseSnapshot& snapshot, int length) const
+    {
+        juce::AudioBuffer<float> impulse(1, length);
+        impulse.clear();
+        if (snapshot.sample_rate <= 0.0)
+        {
+            impulse.setSample(0, length / 2, 1.0f);
+            return impulse;
+        }
+
+        // Zero-phase target magnitude on the FFT grid, delayed by length / 2
+        // (a sign flip on every other bin) so the kernel is centred
+        std::vector<std::complex<float>> spectrum(static_cast<size_t>(length));
+        double peak_magnitude = 0.0;
+        int peak_bin = 0;
+        for (int bin = 0; bin <= length / 2; ++bin)
+        {
+            const double frequency = bin * _sample_rate / length;
+            const double magnitude = std::pow(10.0, magnitudedB(snapshot, ResponseTerms::at(frequency, snapshot.sample_rate)) / 20.0);
+            if (magnitude > peak_magnitude)
+            {
+                peak_magnitude = magnitude;
+                peak_bin = bin;
+            }
+
+            const float value = static_cast<float>((bin % 2 == 0) ? magnitude : -magnitude);
+            spectrum[static_cast<size_t>(bin)] = value;
+            if (bin > 0 && bin < length / 2)
+            {
+                spectrum[static_cast<size_t>(length - bin)] = value;
+            }
+        }
+
+        std::vector<std::complex<float>> kernel(static_cast<size_t>(length));
+        juce::dsp::FFT fft(juce::roundToInt(std::log2(length)));
+        fft.perform(spectrum.data(), kernel.data(), true);
+
+        // Periodic Blackman window, symmetric about length / 2 like the kernel
+        constexpr double two_pi = 6.283185307179586476925;
+        auto* h = impulse.getWritePointer(0);
+        for (int n = 0; n < length; ++n)
+        {
+            const double phase = two_pi * n / length;
+            const double window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+            h[n] = static_cast<float>(kernel[static_cast<size_t>(n)].real() * window);
+        }
+
+        // Windowing smears the response a little; pin the gain where the
+        // target is loudest. This also makes the result independent of the
+        // FFT's inverse scaling convention.
+        std::complex<double> gain = 0.0;
+        const double w = two_pi * peak_bin / length;
+        for (int n = 0; n < length; ++n)
+        {
+            gain += static_cast<double>(h[n]) * std::polar(1.0, -w * n);
+        }
+        if (std::abs(gain) > 0.0)
+        {
+            impulse.applyGain(static_cast<float>(peak_magnitude / std::abs(gain)));
+        }
+        return impulse;
+    }
+
+    const SeqLock<ResponseSnapshot>& _response;
+
+    // Resized in prepare only, while the designer thread is stopped
+    juce::dsp::ConvolutionMessageQueue _queue;
+    std::vector<std::unique_ptr<juce::dsp::Convolution>> _convolutions;
+
+    juce::dsp::ProcessSpec _spec { 44100.0, 0, 0 };
+    double _sample_rate = 44100.0;
+
+    // Set while the designer thread is stopped, which keeps redesigning at
+    // the loaded length
+    int _kernel_length = 0;
+    unsigned int _designed_version = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LinearPhaseFilter)
+};
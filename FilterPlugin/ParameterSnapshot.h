@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+
+//==============================================================================
+// Plain copy of the filter parameters, read from the cached
+// AudioProcessorValueTreeState atomics once per block on the audio thread.
+struct ParameterSnapshot
+{
+    float fc = 1000.0f;
+    float Q = 3.0f;
+    float boost_cut = 0.0f;
+    int filter_type = 1;
+    int slope = 0;
+    int alignment = 0;
+
+    bool operator==(const ParameterSnapshot& other) const
+    {
+        return fc == other.fc
+            && Q == other.Q
+            && boost_cut == other.boost_cut
+            && filter_type == other.filter_type
+            && slope == other.slope
+            && alignment == other.alignment;
+    }
+
+    bool operator!=(const ParameterSnapshot& other) const
+    {
+        return !(*this == other);
+    }
+};
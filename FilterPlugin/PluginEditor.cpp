@@ -9,6 +9,9 @@ FilterPluginAudioProcessorEditor::FilterPluginAudioProcessorEditor (FilterPlugin
       _boost_cut_slider_attachment(*p.getParameterState(), "boost_cut", _boost_cut_slider),
       _filter_type_combo_box_attachment(*p.getParameterState(), "filter_type", _filter_type_combo_box),
       _freq_plot(p)
+#if FILTERPLUGIN_INSTRUMENTATION
+      , _monitor_view(p.getAudioThreadMonitor())
+#endif
 {
     juce::ignoreUnused (processorRef);
     // Make sure that before the constructor has finished, you've set the
@@ -62,6 +65,10 @@ FilterPluginAudioProcessorEditor::FilterPluginAudioProcessorEditor (FilterPlugin
 
     // Frequency plot
     addAndMakeVisible(_freq_plot);
+
+#if FILTERPLUGIN_INSTRUMENTATION
+    addAndMakeVisible(_monitor_view);
+#endif
 }
 
 FilterPluginAudioProcessorEditor::~FilterPluginAudioProcessorEditor()
@@ -83,6 +90,9 @@ void FilterPluginAudioProcessorEditor::resized()
     int component_box = (getWidth() - 5.0f * margin * getHeight()) / 4.0f;
     auto bounds = getBounds();
     bounds.reduce(margin*getHeight(), margin*getHeight());
+#if FILTERPLUGIN_INSTRUMENTATION
+    _monitor_view.setBounds(bounds.removeFromBottom(20));
+#endif
     _freq_plot.setBounds(bounds.removeFromTop(component_box * 2)); // space for filter graph
     
     auto cutoff_box = bounds.removeFromLeft(component_box).reduced(margin * getHeight(), margin * getHeight());
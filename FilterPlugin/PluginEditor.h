@@ -1,6 +1,7 @@
 #pragma once
 
 #include "PluginProcessor.h"
+#include "AudioThreadMonitorView.h"
 #include "FrequencyPlot.h"
 
 //==============================================================================
@@ -36,7 +37,10 @@ private:
     juce::Label _filter_type_combo_box_label;
     juce::AudioProcessorValueTreeState::ComboBoxAttachment _filter_type_combo_box_attachment;
 
-    FrequencyPlot _freq_plot;
+    FrequencyPlot<FilterPluginAudioProcessor> _freq_plot;
+#if FILTERPLUGIN_INSTRUMENTATION
+    AudioThreadMonitorView _monitor_view;
+#endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterPluginAudioProcessorEditor)
 };
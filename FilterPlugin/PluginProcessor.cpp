@@ -7,6 +7,7 @@ FilterPluginAudioProcessor::FilterPluginAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
@@ -20,13 +21,72 @@ FilterPluginAudioProcessor::FilterPluginAudioProcessor()
                                                      ),
         std::make_unique<juce::AudioParameterFloat> ("Q", "Q", 0.0, 10.0, 3.0),
         std::make_unique<juce::AudioParameterFloat> ("boost_cut", "Boost/Cut", -96.0, 24.0, 0.0),
-        std::make_unique<juce::AudioParameterInt> ("filter_type", "Filter Type", 0, rubdsp::filterAlgorithm::NUM_ALGROITHMS - 1, 1)
+        std::make_unique<juce::AudioParameterInt> ("filter_type", "Filter Type", 0, rubdsp::filterAlgorithm::NUM_ALGROITHMS - 1, 1),
+        std::make_unique<juce::AudioParameterChoice> ("update_mode", "Coefficient Update", UPDATE_MODE_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("sub_block", "Update Interval", SUB_BLOCK_NAMES, 2),
+        std::make_unique<juce::AudioParameterChoice> ("accuracy", "Coefficient Accuracy", ACCURACY_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("oversampling", "Oversampling", OVERSAMPLING_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("slope", "Slope", SLOPE_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("alignment", "Cascade Alignment", ALIGNMENT_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("phase", "Phase", PHASE_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("fir_length", "FIR Length", FIR_LENGTH_NAMES, 2),
+        std::make_unique<juce::AudioParameterChoice> ("topology", "Filter Topology", TOPOLOGY_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("dynamic_mode", "Dynamic Mode", DYNAMIC_MODE_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("detector", "Detector", DETECTOR_NAMES, 0),
+        std::make_unique<juce::AudioParameterChoice> ("detector_source", "Detector Source", DETECTOR_SOURCE_NAMES, 0),
+        std::make_unique<juce::AudioParameterFloat> ("threshold", "Threshold", -60.0, 0.0, -24.0),
+        std::make_unique<juce::AudioParameterFloat> ("ratio", "Ratio", 1.0, 20.0, 4.0),
+        std::make_unique<juce::AudioParameterFloat> ("range", "Range", -24.0, 24.0, -12.0),
+        std::make_unique<juce::AudioParameterFloat> ("attack", "Attack", 0.1, 100.0, 5.0),
+        std::make_unique<juce::AudioParameterFloat> ("release", "Release", 5.0, 1000.0, 100.0),
+        std::make_unique<juce::AudioParameterChoice> ("multithreading", "Multithreading", MULTITHREADING_NAMES, 0)
     })
 {
+    _fc_parameter = _parameters.getRawParameterValue("fc");
+    _Q_parameter = _parameters.getRawParameterValue("Q");
+    _boost_cut_parameter = _parameters.getRawParameterValue("boost_cut");
+    _filter_type_parameter = _parameters.getRawParameterValue("filter_type");
+    _update_mode_parameter = _parameters.getRawParameterValue("update_mode");
+    _sub_block_parameter = _parameters.getRawParameterValue("sub_block");
+    _accuracy_parameter = _parameters.getRawParameterValue("accuracy");
+    _oversampling_parameter = _parameters.getRawParameterValue("oversampling");
+    _slope_parameter = _parameters.getRawParameterValue("slope");
+    _alignment_parameter = _parameters.getRawParameterValue("alignment");
+    _phase_parameter = _parameters.getRawParameterValue("phase");
+    _fir_length_parameter = _parameters.getRawParameterValue("fir_length");
+    _topology_parameter = _parameters.getRawParameterValue("topology");
+    _dynamic_mode_parameter = _parameters.getRawParameterValue("dynamic_mode");
+    _detector_parameter = _parameters.getRawParameterValue("detector");
+    _detector_source_parameter = _parameters.getRawParameterValue("detector_source");
+    _threshold_parameter = _parameters.getRawParameterValue("threshold");
+    _ratio_parameter = _parameters.getRawParameterValue("ratio");
+    _range_parameter = _parameters.getRawParameterValue("range");
+    _attack_parameter = _parameters.getRawParameterValue("attack");
+    _release_parameter = _parameters.getRawParameterValue("release");
+    _multithreading_parameter = _parameters.getRawParameterValue("multithreading");
+
+    for (int index = 0; index < NUM_PROGRAMS; ++index)
+    {
+        _programs[static_cast<size_t>(index)].name = "Program " + juce::String(index + 1);
+        storeProgram(index);
+    }
+
+    for (auto* id : PROCESSING_MODE_PARAMETER_IDS)
+    {
+        _parameters.addParameterListener(id, this);
+    }
+    _parameters.addParameterListener(ACCURACY_PARAMETER_ID, this);
 }
 
 FilterPluginAudioProcessor::~FilterPluginAudioProcessor()
 {
+    for (auto* id : PROCESSING_MODE_PARAMETER_IDS)
+    {
+        _parameters.removeParameterListener(id, this);
+    }
+    _parameters.removeParameterListener(ACCURACY_PARAMETER_ID, this);
+    _shared_designs->cancelRequests(*this);
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -64,34 +124,81 @@ bool FilterPluginAudioProcessor::isMidiEffect() const
 
 double FilterPluginAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return _tail_seconds.load();
 }
 
 int FilterPluginAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return NUM_PROGRAMS;
 }
 
 int FilterPluginAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    const juce::ScopedLock lock(_programs_lock);
+    return _current_program;
 }
 
+// Like a classic program bank, edits belong to the current program and are
+// kept when switching away from it.
 void FilterPluginAudioProcessor::setCurrentProgram (int index)
 {
-    juce::ignoreUnused (index);
+    {
+        const juce::ScopedLock lock(_programs_lock);
+        if (index < 0 || index >= NUM_PROGRAMS || index == _current_program)
+            return;
+
+        storeProgram(_current_program);
+        _current_program = index;
+    }
+    loadProgram(index);
 }
 
 const juce::String FilterPluginAudioProcessor::getProgramName (int index)
 {
-    juce::ignoreUnused (index);
-    return {};
+    if (index < 0 || index >= NUM_PROGRAMS)
+        return {};
+    const juce::ScopedLock lock(_programs_lock);
+    return _programs[static_cast<size_t>(index)].name;
 }
 
 void FilterPluginAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
-    juce::ignoreUnused (index, newName);
+    const juce::ScopedLock lock(_programs_lock);
+    if (index >= 0 && index < NUM_PROGRAMS)
+        _programs[static_cast<size_t>(index)].name = newName;
+}
+
+void FilterPluginAudioProcessor::storeProgram(int index)
+{
+    const juce::ScopedLock lock(_programs_lock);
+    readProgramValues(_programs[static_cast<size_t>(index)]);
+}
+
+// Any thread, the parameter values are atomics.
+void FilterPluginAudioProcessor::readProgramValues(Program& program) const
+{
+    for (int i = 0; i < NUM_PROGRAM_PARAMETERS; ++i)
+    {
+        program.values[static_cast<size_t>(i)] = _parameters.getRawParameterValue(PROGRAM_PARAMETER_IDS[i])->load();
+    }
+}
+
+// Sets the parameters from a copy, so no listener runs under the lock.
+void FilterPluginAudioProcessor::loadProgram(int index)
+{
+    Program program;
+    {
+        const juce::ScopedLock lock(_programs_lock);
+        program = _programs[static_cast<size_t>(index)];
+    }
+    for (int i = 0; i < NUM_PROGRAM_PARAMETERS; ++i)
+    {
+        auto* parameter = _parameters.getParameter(PROGRAM_PARAMETER_IDS[i]);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(program.values[static_cast<size_t>(i)]));
+    }
+
+    // Only once all values are in, so the audio thread fades to all of them
+    _crossfade_pending = true;
 }
 
 //==============================================================================
@@ -99,15 +206,122 @@ void FilterPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPe
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    juce::ignoreUnused (sampleRate, samplesPerBlock);
-    _left_filter.reset(sampleRate);
-    _right_filter.reset(sampleRate);
+    auto num_channels = getMainBusNumOutputChannels();
+    _host_sample_rate = sampleRate;
+    _max_block_size = std::max(samplesPerBlock, 1);
+    _linear_phase = static_cast<int>(_phase_parameter->load()) == 1;
+    _fir_length = FIR_LENGTHS[static_cast<int>(_fir_length_parameter->load())];
+    _oversampling = _linear_phase ? 0 : static_cast<int>(_oversampling_parameter->load());
+    _topology = static_cast<FilterTopology>(static_cast<int>(_topology_parameter->load()));
+    _double_precision = isUsingDoublePrecision();
+    _analyzer.prepare(sampleRate);
+    _monitor.prepare(sampleRate);
+    _filter_bank.prepare(num_channels, MAX_FILTER_SECTIONS);
+    _fade_bank.prepare(num_channels, MAX_FILTER_SECTIONS);
+    _envelope_follower.prepare(sampleRate);
+
+    // One thread per SIMD group at most, and none for buses too narrow to gain
+    auto num_groups = (num_channels + SimdVector::size - 1) / SimdVector::size;
+    auto num_workers = num_channels >= PARALLEL_MIN_CHANNELS
+                     ? std::min({ MAX_CHANNEL_WORKERS, juce::SystemStats::getNumCpus() - 1, num_groups - 1 })
+                     : 0;
+    _workers.prepare(std::max(num_workers, 0));
+
+    _envelope_levels.assign(static_cast<size_t>(_max_block_size), 0.0f);
+    _envelope_length = 0;
+    _dynamic_gain = 0.0f;
+    _crossfade_buffer.setSize(num_channels, _max_block_size << (_oversamplers.size() - 1));
+    _oversampled_channels.resize(static_cast<size_t>(num_channels));
+    _double_oversampled_channels.resize(static_cast<size_t>(num_channels));
+
+    for (size_t stages = 1; stages < _oversamplers.size(); ++stages)
+    {
+        _oversamplers[stages].reset();
+        _double_oversamplers[stages].reset();
+        if (_double_precision)
+        {
+            _double_oversamplers[stages] = std::make_unique<juce::dsp::Oversampling<double>>(
+                static_cast<size_t>(num_channels), stages, juce::dsp::Oversampling<double>::filterHalfBandFIREquiripple, false);
+            _double_oversamplers[stages]->initProcessing(static_cast<size_t>(_max_block_size));
+        }
+        else
+        {
+            _oversamplers[stages] = std::make_unique<juce::dsp::Oversampling<float>>(
+                static_cast<size_t>(num_channels), stages, juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple, false);
+            _oversamplers[stages]->initProcessing(static_cast<size_t>(_max_block_size));
+        }
+    }
+
+    if (_double_precision)
+        _linear_phase_buffer.setSize(num_channels, _max_block_size);
+    else
+        _linear_phase_buffer.setSize(0, 0);
+
+    _linear_phase_filter.prepare({ sampleRate, static_cast<juce::uint32>(_max_block_size), static_cast<juce::uint32>(num_channels) });
+
+    updateCoefficientTable();
+
+    _current_parameters = readParameters();
+    _silent_samples = 0;
+    _skipping = false;
+    prepareFilter();
+}
+
+// Everything that depends on the rate the filter runs at, i.e. the host rate
+// times the oversampling factor, and on the processing mode.
+void FilterPluginAudioProcessor::prepareFilter()
+{
+    _sample_rate = _host_sample_rate * (1 << _oversampling);
+    _designer.reset(_sample_rate);
+    _filter_bank.setTopology(_topology);
+    _fade_bank.setTopology(_topology);
+    _crossfade_length = std::max(1, juce::roundToInt(PROGRAM_CROSSFADE_SECONDS * _sample_rate));
+    _crossfade_remaining = 0;
+
+    _fc_smoother.reset(_sample_rate, SMOOTHING_TIME_SECONDS);
+    _fc_smoother.setCurrentAndTargetValue(_current_parameters.fc);
+    _Q_smoother.reset(_sample_rate, SMOOTHING_TIME_SECONDS);
+    _Q_smoother.setCurrentAndTargetValue(_current_parameters.Q);
+    _boost_cut_smoother.reset(_sample_rate, SMOOTHING_TIME_SECONDS);
+    _boost_cut_smoother.setCurrentAndTargetValue(_current_parameters.boost_cut);
+    _parameters_dirty = true;
+    _samples_until_update = 0;
+    updateFilter(0, _dynamic_gain);
+
+    // The FIR kernel is designed from the response updateFilter just
+    // published and runs from the next block on, so the latency reported is
+    // always that of the kernel running. In IIR mode its designer thread
+    // isn't needed.
+    int latency = 0;
+    if (_linear_phase)
+    {
+        _linear_phase_filter.loadKernel(_fir_length);
+        latency = _linear_phase_filter.getLatencySamples();
+    }
+    else
+    {
+        _linear_phase_filter.release();
+        if (auto& oversampler = _oversamplers[static_cast<size_t>(_oversampling)])
+        {
+            oversampler->reset();
+            latency = juce::roundToInt(oversampler->getLatencyInSamples());
+        }
+        else if (auto& double_oversampler = _double_oversamplers[static_cast<size_t>(_oversampling)])
+        {
+            double_oversampler->reset();
+            latency = juce::roundToInt(double_oversampler->getLatencyInSamples());
+        }
+    }
+    setLatencySamples(latency);
+    updateTail(_filter_bank.getNumSections());
 }
 
 void FilterPluginAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    _linear_phase_filter.release();
+    _workers.release();
 }
 
 bool FilterPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
@@ -116,10 +330,9 @@ bool FilterPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // The filter bank is sized from the bus in prepareToPlay, so any
+    // non-empty layout works (surround, immersive, ambisonic...).
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -132,11 +345,53 @@ bool FilterPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
   #endif
 }
 
+bool FilterPluginAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
 void FilterPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                               juce::MidiBuffer& midiMessages)
 {
     juce::ignoreUnused (midiMessages);
+    processBlockImpl(buffer);
+}
+
+void FilterPluginAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer,
+                                              juce::MidiBuffer& midiMessages)
+{
+    juce::ignoreUnused (midiMessages);
+    processBlockImpl(buffer);
+}
 
+template <>
+FilterPluginAudioProcessor::Oversamplers<float>& FilterPluginAudioProcessor::getOversamplers<float>()
+{
+    return _oversamplers;
+}
+
+template <>
+FilterPluginAudioProcessor::Oversamplers<double>& FilterPluginAudioProcessor::getOversamplers<double>()
+{
+    return _double_oversamplers;
+}
+
+template <>
+std::vector<float*>& FilterPluginAudioProcessor::getOversampledChannels<float>()
+{
+    return _oversampled_channels;
+}
+
+template <>
+std::vector<double*>& FilterPluginAudioProcessor::getOversampledChannels<double>()
+{
+    return _double_oversampled_channels;
+}
+
+template <typename SampleType>
+void FilterPluginAudioProcessor::processBlockImpl (juce::AudioBuffer<SampleType>& buffer)
+{
+    AudioThreadMonitor::ScopedBlock monitor_block(_monitor, buffer.getNumSamples());
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -150,32 +405,502 @@ void FilterPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    auto parameters = _left_filter.getParameters();
-    parameters.fc = *_parameters.getRawParameterValue("fc");
-    parameters.Q = *_parameters.getRawParameterValue("Q");
-    parameters.boost_cut_db = *_parameters.getRawParameterValue("boost_cut");
-    
-    int algorithm_index = _parameters.getParameterAsValue("filter_type").getValue();
-    parameters.algorithm = static_cast<rubdsp::filterAlgorithm>(algorithm_index);
+    // The flag goes first: a program change or restore stores all of its
+    // values before raising it, so the snapshot taken after it is guaranteed
+    // to hold them and the crossfade lands on the complete new setting.
+    auto crossfade = _crossfade_pending.exchange(false);
+    auto snapshot = readParameters();
+    if (snapshot != _current_parameters)
+    {
+        _fc_smoother.setTargetValue(snapshot.fc);
+        _Q_smoother.setTargetValue(snapshot.Q);
+        _boost_cut_smoother.setTargetValue(snapshot.boost_cut);
+        if (snapshot.filter_type != _current_parameters.filter_type
+            || snapshot.slope != _current_parameters.slope
+            || snapshot.alignment != _current_parameters.alignment)
+        {
+            _parameters_dirty = true;
+        }
+        _current_parameters = snapshot;
+    }
+
+    if (crossfade)
+    {
+        startCrossfade();
+    }
 
+    auto channels = buffer.getArrayOfWritePointers();
+    auto num_samples = buffer.getNumSamples();
+    _analyzer.push(SpectrumAnalyzer::input, channels, totalNumOutputChannels, num_samples);
 
-    _left_filter.setParameters(parameters);
-    _right_filter.setParameters(parameters);
+    // An FIR kernel can't be redesigned anywhere near as fast as an envelope
+    // moves, so the dynamic modes only apply to the IIR path.
+    auto dynamic_mode = _linear_phase ? 0 : static_cast<int>(_dynamic_mode_parameter->load());
+    if (dynamic_mode != _dynamic_mode)
+    {
+        _dynamic_mode = dynamic_mode;
+        _parameters_dirty = true;
+    }
+    if (_dynamic_mode != 0)
+    {
+        _envelope_follower.setDetector(static_cast<EnvelopeDetector>(static_cast<int>(_detector_parameter->load())));
+        _envelope_follower.setTimes(_attack_parameter->load(), _release_parameter->load());
+    }
 
-    for (auto channel = 0; channel < buffer.getNumChannels(); ++channel)
+    // Once the input has been silent for longer than the filter rings, the
+    // output is silent too and there is nothing to compute. Only the main bus
+    // is filtered; a sidechain that isn't silent changes nothing about that.
+    auto input_silent = true;
+    auto num_main_inputs = getMainBusNumInputChannels();
+    for (int channel = 0; channel < num_main_inputs && input_silent; ++channel)
     {
-        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+        auto range = buffer.findMinMax(channel, 0, num_samples);
+        input_silent = std::max(-range.getStart(), range.getEnd()) <= SILENCE_THRESHOLD;
+    }
+
+    if (!input_silent)
+    {
+        _silent_samples = 0;
+    }
+    else if (_silent_samples >= _tail_samples)
+    {
+        if (!_skipping)
         {
-            if (channel == 0)
+            // Whatever is left in the state is below the decay threshold
+            _skipping = true;
+            _filter_bank.reset();
+            _linear_phase_filter.reset();
+            for (auto& oversampler : _oversamplers)
+            {
+                if (oversampler != nullptr)
+                    oversampler->reset();
+            }
+            for (auto& oversampler : _double_oversamplers)
             {
-                buffer.setSample(channel, sample, _left_filter.processAudioSample(buffer.getSample(channel, sample)));
+                if (oversampler != nullptr)
+                    oversampler->reset();
             }
-            else if (channel == 1)
+        }
+
+        // The smoothers and the envelope keep moving, so the first block
+        // that isn't silent carries on from where they would be instead of
+        // jumping. The coefficients catch up with them in that block.
+        _fc_smoother.skip(num_samples << _oversampling);
+        _Q_smoother.skip(num_samples << _oversampling);
+        _boost_cut_smoother.skip(num_samples << _oversampling);
+        if (_dynamic_mode != 0)
+        {
+            for (int start = 0; start < num_samples; start += _max_block_size)
             {
-                buffer.setSample(channel, sample, _right_filter.processAudioSample(buffer.getSample(channel, sample)));
+                detectEnvelope(buffer, start, std::min(num_samples - start, _max_block_size));
             }
         }
+        _parameters_dirty = true;
+
+        ++_skipped_blocks;
+        for (auto i = 0; i < totalNumOutputChannels; ++i)
+            buffer.clear (i, 0, num_samples);
+        _analyzer.push(SpectrumAnalyzer::output, channels, totalNumOutputChannels, num_samples);
+        return;
+    }
+    else
+    {
+        _silent_samples += num_samples;
+    }
+    _skipping = false;
+
+    // The oversamplers can't take more than the block size they were prepared for
+    auto num_channels = std::min(totalNumOutputChannels, _filter_bank.getNumChannels());
+    juce::dsp::AudioBlock<SampleType> block(channels, static_cast<size_t>(num_channels), static_cast<size_t>(num_samples));
+    for (int start = 0; start < num_samples; start += _max_block_size)
+    {
+        auto length = std::min(num_samples - start, _max_block_size);
+        if (_dynamic_mode != 0)
+        {
+            detectEnvelope(buffer, start, length);
+        }
+        processFilter(block.getSubBlock(static_cast<size_t>(start), static_cast<size_t>(length)));
     }
+
+    _analyzer.push(SpectrumAnalyzer::output, channels, totalNumOutputChannels, num_samples);
+}
+
+// Any thread, including the audio thread when the host automates the mode.
+void FilterPluginAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    juce::ignoreUnused(parameterID, newValue);
+    triggerAsyncUpdate();
+}
+
+// Message thread. Resetting the oversamplers and the convolution and
+// reporting the new latency don't belong on the audio thread, so the mode is
+// switched here while processBlock is held off by the callback lock. Also
+// where a coefficient table arrives once SharedDesigns has built it.
+void FilterPluginAudioProcessor::handleAsyncUpdate()
+{
+    // Not prepared yet, prepareToPlay picks the mode up
+    if (_max_block_size == 0)
+        return;
+
+    auto linear_phase = static_cast<int>(_phase_parameter->load()) == 1;
+    auto fir_length = FIR_LENGTHS[static_cast<int>(_fir_length_parameter->load())];
+    // The FIR kernel is designed for the host rate, it never runs oversampled
+    auto oversampling = linear_phase ? 0 : static_cast<int>(_oversampling_parameter->load());
+    auto topology = static_cast<FilterTopology>(static_cast<int>(_topology_parameter->load()));
+    if (oversampling != _oversampling || linear_phase != _linear_phase || fir_length != _fir_length
+        || topology != _topology)
+    {
+        const juce::ScopedLock lock(getCallbackLock());
+        _oversampling = oversampling;
+        _topology = topology;
+        _linear_phase = linear_phase;
+        _fir_length = fir_length;
+        prepareFilter();
+    }
+
+    updateCoefficientTable();
+}
+
+// Message thread. The table is only needed with Table accuracy, for the rate
+// the filter runs at, and instances at the same rate share one. If it hasn't
+// been built yet SharedDesigns builds it in the background and triggers
+// handleAsyncUpdate when it's there; until then updateFilter designs exactly.
+void FilterPluginAudioProcessor::updateCoefficientTable()
+{
+    if (static_cast<int>(_accuracy_parameter->load()) != 1)
+        return;
+
+    const auto sample_rate = _host_sample_rate * (1 << _oversampling);
+    if (_coefficient_table != nullptr && _coefficient_table->isBuiltFor(sample_rate))
+        return;
+
+    auto table = _shared_designs->findTable(sample_rate);
+    if (table == nullptr)
+    {
+        _shared_designs->requestTable(sample_rate, *this);
+        return;
+    }
+
+    // The old table is let go of outside the lock
+    const juce::ScopedLock lock(getCallbackLock());
+    std::swap(_coefficient_table, table);
+}
+
+template <typename SampleType>
+void FilterPluginAudioProcessor::processFilter(juce::dsp::AudioBlock<SampleType> block)
+{
+    auto& oversampler = getOversamplers<SampleType>()[static_cast<size_t>(_oversampling)];
+    auto filter_block = oversampler != nullptr ? oversampler->processSamplesUp(block) : block;
+
+    auto& filter_channels = getOversampledChannels<SampleType>();
+    auto num_channels = static_cast<int>(filter_block.getNumChannels());
+    auto num_samples = static_cast<int>(filter_block.getNumSamples());
+    for (int channel = 0; channel < num_channels; ++channel)
+    {
+        filter_channels[static_cast<size_t>(channel)] = filter_block.getChannelPointer(static_cast<size_t>(channel));
+    }
+
+    // Coefficients are updated on a fixed grid of sub-blocks that carries
+    // across calls, so the output doesn't depend on the host's block size.
+    // The grid is scaled with the oversampling factor to keep its duration.
+    // In linear phase mode the grid still drives the design, which the FIR
+    // kernel designer picks up from the published response.
+    //
+    // Sub-blocks that don't change the coefficients are run through the bank
+    // together from `pending` on, so a steady filter takes one call per block,
+    // which is also what makes it worth splitting across the workers.
+    auto* workers = static_cast<int>(_multithreading_parameter->load()) == 1 ? &_workers : nullptr;
+    auto run_bank = [&](int start, int length)
+    {
+        if (!_linear_phase && length > 0)
+            _filter_bank.process(filter_channels.data(), num_channels, start, length, workers);
+    };
+
+    int position = 0;
+    int pending = 0;
+    while (position < num_samples)
+    {
+        if (_samples_until_update == 0)
+        {
+            _samples_until_update = SUB_BLOCK_SIZES[static_cast<int>(_sub_block_parameter->load())] << _oversampling;
+            // The design is for the end of the sub-block, so is the level
+            auto dynamic_gain = 0.0f;
+            if (_dynamic_mode != 0)
+            {
+                auto index = std::min((position + _samples_until_update) >> _oversampling, _envelope_length) - 1;
+                dynamic_gain = getDynamicGain(std::max(index, 0));
+            }
+            if (filterNeedsUpdate(dynamic_gain))
+            {
+                run_bank(pending, position - pending);
+                pending = position;
+                updateFilter(_samples_until_update, dynamic_gain);
+            }
+        }
+
+        auto chunk = std::min(num_samples - position, _samples_until_update);
+        auto fade = _linear_phase ? 0 : std::min(chunk, _crossfade_remaining);
+        if (fade > 0)
+        {
+            run_bank(pending, position - pending);
+            processOutgoing(filter_channels.data(), num_channels, position, fade);
+            run_bank(position, chunk);
+            mixOutgoing(filter_channels.data(), num_channels, position, fade);
+            pending = position + chunk;
+        }
+        position += chunk;
+        _samples_until_update -= chunk;
+    }
+    run_bank(pending, num_samples - pending);
+
+    if (_linear_phase)
+    {
+        processLinearPhase(block);
+    }
+    else if (oversampler != nullptr)
+    {
+        oversampler->processSamplesDown(block);
+    }
+}
+
+// Jumps to the new settings, with no smoothing, while the old ones keep
+// running on a copy of the bank that still has all of their state. The
+// linear phase convolution crossfades between kernels by itself.
+void FilterPluginAudioProcessor::startCrossfade()
+{
+    if (!_linear_phase)
+    {
+        _fade_bank = _filter_bank; // same size, so this copies without allocating
+        _crossfade_remaining = _crossfade_length;
+    }
+
+    _fc_smoother.setCurrentAndTargetValue(_current_parameters.fc);
+    _Q_smoother.setCurrentAndTargetValue(_current_parameters.Q);
+    _boost_cut_smoother.setCurrentAndTargetValue(_current_parameters.boost_cut);
+    _parameters_dirty = true;
+    _samples_until_update = 0;
+}
+
+template <typename SampleType>
+void FilterPluginAudioProcessor::processOutgoing(SampleType* const* channels, int numChannels, int startSample, int numSamples)
+{
+    auto outgoing = _crossfade_buffer.getArrayOfWritePointers();
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        for (int i = startSample; i < startSample + numSamples; ++i)
+            outgoing[channel][i] = channels[channel][i];
+    }
+    _fade_bank.process(outgoing, numChannels, startSample, numSamples);
+}
+
+template <typename SampleType>
+void FilterPluginAudioProcessor::mixOutgoing(SampleType* const* channels, int numChannels, int startSample, int numSamples)
+{
+    auto outgoing = _crossfade_buffer.getArrayOfReadPointers();
+    const int faded = _crossfade_length - _crossfade_remaining;
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const double gain = static_cast<double>(faded + i + 1) / _crossfade_length;
+            const double old_sample = outgoing[channel][startSample + i];
+            const double new_sample = channels[channel][startSample + i];
+            channels[channel][startSample + i] = static_cast<SampleType>(old_sample + gain * (new_sample - old_sample));
+        }
+    }
+    _crossfade_remaining -= numSamples;
+}
+
+void FilterPluginAudioProcessor::processLinearPhase(juce::dsp::AudioBlock<float> block)
+{
+    _linear_phase_filter.process(block);
+}
+
+void FilterPluginAudioProcessor::processLinearPhase(juce::dsp::AudioBlock<double> block)
+{
+    auto num_channels = block.getNumChannels();
+    auto num_samples = static_cast<int>(block.getNumSamples());
+    for (size_t channel = 0; channel < num_channels; ++channel)
+    {
+        auto* source = block.getChannelPointer(channel);
+        auto* destination = _linear_phase_buffer.getWritePointer(static_cast<int>(channel));
+        for (int i = 0; i < num_samples; ++i)
+            destination[i] = static_cast<float>(source[i]);
+    }
+
+    juce::dsp::AudioBlock<float> scratch(_linear_phase_buffer);
+    auto scratch_block = scratch.getSubsetChannelBlock(0, num_channels).getSubBlock(0, block.getNumSamples());
+    _linear_phase_filter.process(scratch_block);
+
+    for (size_t channel = 0; channel < num_channels; ++channel)
+    {
+        auto* source = _linear_phase_buffer.getReadPointer(static_cast<int>(channel));
+        auto* destination = block.getChannelPointer(channel);
+        for (int i = 0; i < num_samples; ++i)
+            destination[i] = source[i];
+    }
+}
+
+// Runs on the host rate input before it is filtered, or on the sidechain bus
+// when that is selected and the host has enabled it.
+template <typename SampleType>
+void FilterPluginAudioProcessor::detectEnvelope(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples)
+{
+    auto use_sidechain = static_cast<int>(_detector_source_parameter->load()) == 1
+                      && getBusCount(true) > 1 && getBus(true, 1)->isEnabled();
+    auto source = getBusBuffer(buffer, true, use_sidechain ? 1 : 0);
+    _envelope_follower.process(source.getArrayOfReadPointers(), source.getNumChannels(), startSample, numSamples, _envelope_levels.data());
+    _envelope_length = numSamples;
+}
+
+// Gain change in dB for the envelope at the given sample of the chunk: the
+// level above threshold, compressed by the ratio, up to the range. A
+// negative range cuts, a positive one boosts.
+float FilterPluginAudioProcessor::getDynamicGain(int index) const
+{
+    auto level = _envelope_follower.toDecibels(_envelope_levels[static_cast<size_t>(index)]);
+    auto over = level - _threshold_parameter->load();
+    if (over <= 0.0f)
+        return 0.0f;
+
+    auto change = over * (1.0f - 1.0f / _ratio_parameter->load());
+    auto range = _range_parameter->load();
+    return range < 0.0f ? -std::min(change, -range) : std::min(change, range);
+}
+
+bool FilterPluginAudioProcessor::filterNeedsUpdate(float dynamicGain) const
+{
+    auto smoothing = _fc_smoother.isSmoothing() || _Q_smoother.isSmoothing() || _boost_cut_smoother.isSmoothing();
+    auto dynamics_moved = std::abs(dynamicGain - _dynamic_gain) >= DYNAMIC_GAIN_RESOLUTION
+                       || (dynamicGain == 0.0f && _dynamic_gain != 0.0f);
+    return smoothing || _parameters_dirty || dynamics_moved;
+}
+
+void FilterPluginAudioProcessor::updateFilter(int numSamples, float dynamicGain)
+{
+    if (!filterNeedsUpdate(dynamicGain))
+        return;
+
+    _parameters_dirty = false;
+    _dynamic_gain = dynamicGain;
+
+    // Design for where the smoothers will be at the end of this sub-block
+    auto fc = _fc_smoother.skip(numSamples);
+    auto Q = _Q_smoother.skip(numSamples);
+    auto boost_cut = _boost_cut_smoother.skip(numSamples);
+
+    // Only designs that stay put are worth sharing. Every sub-block of a
+    // glide or of the envelope is a setting nobody asks for again, and
+    // caching those would just push the settled ones out.
+    const auto settled = !_fc_smoother.isSmoothing() && !_Q_smoother.isSmoothing() && !_boost_cut_smoother.isSmoothing()
+                      && _dynamic_gain == 0.0f;
+    if (_dynamic_mode == 1)
+    {
+        boost_cut += _dynamic_gain;
+    }
+    else if (_dynamic_mode == 2)
+    {
+        fc = juce::jlimit(10.0f, 20000.0f, fc * std::exp2(_dynamic_gain / DYNAMIC_DB_PER_OCTAVE));
+    }
+
+    // Steeper slopes cascade sections of the same algorithm with Butterworth
+    // or Linkwitz-Riley Qs instead of the Q knob. That only makes sense for the
+    // second-order types that take a Q and no gain, the rest stay one section.
+    auto filter_type = _current_parameters.filter_type;
+    const auto* table = _coefficient_table.get();
+    int num_sections = 1;
+    CascadeQs Qs {};
+    Qs[0] = Q;
+    if (_current_parameters.slope > 0 && _designer.usesQ(filter_type) && !_designer.usesGain(filter_type))
+    {
+        num_sections = _current_parameters.slope + 1;
+        designCascade(static_cast<CascadeAlignment>(_current_parameters.alignment), num_sections, Qs);
+    }
+    _filter_bank.setNumSections(num_sections);
+
+    // "Exact" always designs, the dynamic modes included: they redesign every
+    // sub-block the envelope moves, and "Table" is the cheap choice for that.
+    auto use_table = static_cast<int>(_accuracy_parameter->load()) == 1
+                  && table != nullptr && table->isBuiltFor(_sample_rate);
+    for (int section = 0; section < num_sections; ++section)
+    {
+        auto& coefficients = _coefficients[static_cast<size_t>(section)];
+        auto section_Q = Qs[static_cast<size_t>(section)];
+        if (use_table)
+        {
+            coefficients = table->lookup(filter_type, fc, section_Q, boost_cut);
+        }
+        else
+        {
+            const DesignKey key { filter_type, fc, section_Q, boost_cut, _sample_rate };
+            if (!settled || !_shared_designs->find(key, coefficients))
+            {
+                // Other instances with the same settings pick this design up
+                // from the shared cache instead of designing it again.
+                auto parameters = _designer.getParameters();
+                parameters.fc = fc;
+                parameters.Q = section_Q;
+                parameters.boost_cut_db = boost_cut;
+                parameters.algorithm = static_cast<rubdsp::filterAlgorithm>(filter_type);
+                coefficients = _designer.design(parameters);
+                if (settled)
+                    _shared_designs->insert(key, coefficients);
+            }
+        }
+    }
+
+    _response.store({ _coefficients, num_sections, _sample_rate });
+    updateTail(num_sections);
+
+    auto ramp = static_cast<int>(_update_mode_parameter->load()) == 0;
+    for (int section = 0; section < num_sections; ++section)
+    {
+        if (ramp)
+        {
+            _filter_bank.rampCoefficients(section, _coefficients[static_cast<size_t>(section)], numSamples);
+        }
+        else
+        {
+            _filter_bank.setCoefficients(section, _coefficients[static_cast<size_t>(section)]);
+        }
+    }
+}
+
+void FilterPluginAudioProcessor::updateTail(int numSections)
+{
+    double radius = 0.0;
+    for (int section = 0; section < numSections; ++section)
+    {
+        radius = std::max(radius, poleRadius(_coefficients[static_cast<size_t>(section)]));
+    }
+
+    // The FIR kernel is exactly as long as it is, the IIR rings until its
+    // slowest pole has decayed by TAIL_DECAY
+    double tail_seconds = MAX_TAIL_SECONDS;
+    if (_linear_phase)
+    {
+        tail_seconds = _fir_length / _host_sample_rate;
+    }
+    else if (radius < 1.0)
+    {
+        auto decay_samples = radius > 0.0 ? std::log(TAIL_DECAY) / std::log(radius) : 2.0;
+        tail_seconds = std::min(MAX_TAIL_SECONDS, decay_samples / _sample_rate);
+    }
+
+    _tail_samples = static_cast<juce::int64>(std::ceil(tail_seconds * _host_sample_rate)) + getLatencySamples();
+    _tail_seconds = _tail_samples / _host_sample_rate;
+}
+
+ParameterSnapshot FilterPluginAudioProcessor::readParameters() const
+{
+    ParameterSnapshot snapshot;
+    snapshot.fc = _fc_parameter->load();
+    snapshot.Q = _Q_parameter->load();
+    snapshot.boost_cut = _boost_cut_parameter->load();
+    snapshot.filter_type = static_cast<int>(_filter_type_parameter->load());
+    snapshot.slope = static_cast<int>(_slope_parameter->load());
+    snapshot.alignment = static_cast<int>(_alignment_parameter->load());
+    return snapshot;
 }
 
 //==============================================================================
@@ -190,19 +915,64 @@ juce::AudioProcessorEditor* FilterPluginAudioProcessor::createEditor()
 }
 
 //==============================================================================
+// Hosts may ask for the state from any thread, so the bank is left alone and
+// a copy of it, taken under the lock, is saved, with the current program's
+// values taken straight from the parameters.
 void FilterPluginAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-    juce::ignoreUnused (destData);
+    int current_program = 0;
+    std::array<Program, NUM_PROGRAMS> bank;
+    {
+        const juce::ScopedLock lock(_programs_lock);
+        current_program = _current_program;
+        bank = _programs;
+    }
+    readProgramValues(bank[static_cast<size_t>(current_program)]);
+
+    juce::ValueTree programs("PROGRAMS");
+    programs.setProperty("current", current_program, nullptr);
+    for (const auto& program : bank)
+    {
+        juce::ValueTree child("PROGRAM");
+        child.setProperty("name", program.name, nullptr);
+        for (int i = 0; i < NUM_PROGRAM_PARAMETERS; ++i)
+        {
+            child.setProperty(PROGRAM_PARAMETER_IDS[i], program.values[static_cast<size_t>(i)], nullptr);
+        }
+        programs.appendChild(child, nullptr);
+    }
+
+    auto state = _parameters.copyState();
+    state.appendChild(programs, nullptr);
+    writeState(state, destData);
 }
 
 void FilterPluginAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    juce::ignoreUnused (data, sizeInBytes);
+    auto state = readState(data, sizeInBytes);
+    if (!state.hasType(_parameters.state.getType()))
+        return;
+
+    // Programs missing from an older state keep what they have
+    auto programs = state.getChildWithName("PROGRAMS");
+    {
+        const juce::ScopedLock lock(_programs_lock);
+        for (int index = 0; index < std::min(programs.getNumChildren(), NUM_PROGRAMS); ++index)
+        {
+            auto child = programs.getChild(index);
+            auto& program = _programs[static_cast<size_t>(index)];
+            program.name = child.getProperty("name", program.name);
+            for (int i = 0; i < NUM_PROGRAM_PARAMETERS; ++i)
+            {
+                program.values[static_cast<size_t>(i)] = child.getProperty(PROGRAM_PARAMETER_IDS[i], program.values[static_cast<size_t>(i)]);
+            }
+        }
+        _current_program = juce::jlimit(0, NUM_PROGRAMS - 1, static_cast<int>(programs.getProperty("current", 0)));
+    }
+    state.removeChild(programs, nullptr);
+
+    _parameters.replaceState(state);
+    _crossfade_pending = true;
 }
 
 //==============================================================================
@@ -1,11 +1,65 @@
 #pragma once
 
 #include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_dsp/juce_dsp.h>
 
 #include "audio_filter.h"
+#include "AudioThreadMonitor.h"
+#include "CascadeDesign.h"
+#include "CoefficientTable.h"
+#include "EnvelopeFollower.h"
+#include "FilterBank.h"
+#include "FilterDesigner.h"
+#include "FrequencyResponse.h"
+#include "LinearPhaseFilter.h"
+#include "ParameterSnapshot.h"
+#include "PluginState.h"
+#include "SeqLock.h"
+#include "SharedDesigns.h"
+#include "SpectrumAnalyzer.h"
+
+namespace
+{
+    constexpr double SMOOTHING_TIME_SECONDS = 0.02;
+    const juce::StringArray UPDATE_MODE_NAMES = { "Interpolate coefficients", "Recompute per sub-block" };
+    const juce::StringArray SUB_BLOCK_NAMES = { "8", "16", "32", "64" };
+    constexpr int SUB_BLOCK_SIZES[] = { 8, 16, 32, 64 };
+    const juce::StringArray ACCURACY_NAMES = { "Exact", "Table" };
+    const juce::StringArray OVERSAMPLING_NAMES = { "Off", "2x", "4x", "8x" };
+    const juce::StringArray SLOPE_NAMES = { "12 dB/oct", "24 dB/oct", "36 dB/oct", "48 dB/oct" };
+    const juce::StringArray ALIGNMENT_NAMES = { "Butterworth", "Linkwitz-Riley" };
+    const juce::StringArray PHASE_NAMES = { "Minimum phase (IIR)", "Linear phase (FIR)" };
+    const juce::StringArray TOPOLOGY_NAMES = { "Direct form II (transposed)", "State variable (TPT)" };
+    const juce::StringArray FIR_LENGTH_NAMES = { "1024", "2048", "4096", "8192", "16384" };
+    constexpr int FIR_LENGTHS[] = { 1024, 2048, 4096, 8192, 16384 };
+    constexpr float SILENCE_THRESHOLD = 1.0e-8f; // -160 dBFS
+    constexpr double TAIL_DECAY = 1.0e-6; // -120 dB
+    constexpr double MAX_TAIL_SECONDS = 10.0;
+    const juce::StringArray DYNAMIC_MODE_NAMES = { "Off", "Boost/Cut", "Cutoff" };
+    const juce::StringArray DETECTOR_NAMES = { "Peak", "RMS" };
+    const juce::StringArray DETECTOR_SOURCE_NAMES = { "Input", "Sidechain" };
+    const juce::StringArray MULTITHREADING_NAMES = { "Off", "Channel workers" };
+    constexpr float DYNAMIC_DB_PER_OCTAVE = 6.0f; // cutoff mode: how far 1 dB of range moves fc
+    constexpr float DYNAMIC_GAIN_RESOLUTION = 0.05f; // smaller changes don't redesign
+
+    // Programs hold the parameters that make up a filter setting; the
+    // processing mode (oversampling, phase, topology...) stays as it is.
+    constexpr int NUM_PROGRAMS = 8;
+    constexpr int NUM_PROGRAM_PARAMETERS = 6;
+    constexpr const char* PROGRAM_PARAMETER_IDS[NUM_PROGRAM_PARAMETERS] = { "fc", "Q", "boost_cut", "filter_type", "slope", "alignment" };
+    constexpr double PROGRAM_CROSSFADE_SECONDS = 0.05;
+
+    // Changing any of these re-prepares the filter, see handleAsyncUpdate
+    constexpr const char* PROCESSING_MODE_PARAMETER_IDS[] = { "phase", "fir_length", "oversampling", "topology" };
+
+    // Changing this fetches the coefficient table, see updateCoefficientTable
+    constexpr const char* ACCURACY_PARAMETER_ID = "accuracy";
+}
 
 //==============================================================================
-class FilterPluginAudioProcessor  : public juce::AudioProcessor
+class FilterPluginAudioProcessor  : public juce::AudioProcessor,
+                                    private juce::AudioProcessorValueTreeState::Listener,
+                                    private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -19,7 +73,11 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-    using AudioProcessor::processBlock;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    // The filter always runs in double; a double precision host buffer just
+    // saves the conversions on the way in and out.
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -48,14 +106,183 @@ public:
         return &_parameters;
     }
 
+    // Safe to call from any thread, only reads the published snapshot.
     double getMagnitudedB(double frequency) {
-        return _left_filter.getMagnitudedB(frequency);
+        auto snapshot = _response.load();
+        if (snapshot.sample_rate <= 0.0)
+            return 0.0;
+        return magnitudedB(snapshot, ResponseTerms::at(frequency, snapshot.sample_rate));
+    }
+
+    // Bumped every time the filter coefficients change, so the editor only
+    // re-evaluates the response when there is something new to show.
+    unsigned int getResponseVersion() const {
+        return _response.getVersion();
+    }
+
+    ResponseSnapshot getResponseSnapshot() const {
+        return _response.load();
+    }
+
+    SpectrumAnalyzer& getAnalyzer() {
+        return _analyzer;
+    }
+
+    // Number of blocks that were skipped because the input was silent and the
+    // filter had rung out.
+    juce::uint64 getSkippedBlockCount() const {
+        return _skipped_blocks.load();
+    }
+
+    // Only collects anything in FILTERPLUGIN_INSTRUMENTATION builds.
+    AudioThreadMonitor& getAudioThreadMonitor() {
+        return _monitor;
     }
 
 private:
+    template <typename SampleType>
+    using Oversamplers = std::array<std::unique_ptr<juce::dsp::Oversampling<SampleType>>, 4>;
+
+    struct Program
+    {
+        juce::String name;
+        std::array<float, NUM_PROGRAM_PARAMETERS> values {};
+    };
+
+    void storeProgram(int index);
+    void readProgramValues(Program& program) const;
+    void loadProgram(int index);
+    void startCrossfade();
+    template <typename SampleType>
+    void processOutgoing(SampleType* const* channels, int numChannels, int startSample, int numSamples);
+    template <typename SampleType>
+    void mixOutgoing(SampleType* const* channels, int numChannels, int startSample, int numSamples);
+
+    ParameterSnapshot readParameters() const;
+    void prepareFilter();
+    void updateCoefficientTable();
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    template <typename SampleType>
+    void processBlockImpl(juce::AudioBuffer<SampleType>& buffer);
+    template <typename SampleType>
+    void processFilter(juce::dsp::AudioBlock<SampleType> block);
+    template <typename SampleType>
+    Oversamplers<SampleType>& getOversamplers();
+    template <typename SampleType>
+    std::vector<SampleType*>& getOversampledChannels();
+    void processLinearPhase(juce::dsp::AudioBlock<float> block);
+    void processLinearPhase(juce::dsp::AudioBlock<double> block);
+    template <typename SampleType>
+    void detectEnvelope(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples);
+    float getDynamicGain(int index) const;
+    bool filterNeedsUpdate(float dynamicGain) const;
+    void updateFilter(int numSamples, float dynamicGain);
+    void updateTail(int numSections);
+
     juce::AudioProcessorValueTreeState _parameters;
-    rubdsp::AudioFilter _left_filter;
-    rubdsp::AudioFilter _right_filter;
+    std::atomic<float>* _fc_parameter = nullptr;
+    std::atomic<float>* _Q_parameter = nullptr;
+    std::atomic<float>* _boost_cut_parameter = nullptr;
+    std::atomic<float>* _filter_type_parameter = nullptr;
+    std::atomic<float>* _update_mode_parameter = nullptr;
+    std::atomic<float>* _sub_block_parameter = nullptr;
+    std::atomic<float>* _accuracy_parameter = nullptr;
+    std::atomic<float>* _oversampling_parameter = nullptr;
+    std::atomic<float>* _slope_parameter = nullptr;
+    std::atomic<float>* _alignment_parameter = nullptr;
+    std::atomic<float>* _phase_parameter = nullptr;
+    std::atomic<float>* _fir_length_parameter = nullptr;
+    std::atomic<float>* _topology_parameter = nullptr;
+    std::atomic<float>* _dynamic_mode_parameter = nullptr;
+    std::atomic<float>* _detector_parameter = nullptr;
+    std::atomic<float>* _detector_source_parameter = nullptr;
+    std::atomic<float>* _threshold_parameter = nullptr;
+    std::atomic<float>* _ratio_parameter = nullptr;
+    std::atomic<float>* _range_parameter = nullptr;
+    std::atomic<float>* _attack_parameter = nullptr;
+    std::atomic<float>* _release_parameter = nullptr;
+    std::atomic<float>* _multithreading_parameter = nullptr;
+    ParameterSnapshot _current_parameters;
+    bool _parameters_dirty = true;
+
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> _fc_smoother;
+    juce::SmoothedValue<float> _Q_smoother;
+    juce::SmoothedValue<float> _boost_cut_smoother;
+    int _samples_until_update = 0;
+
+    FilterDesigner _designer;
+    juce::SharedResourcePointer<SharedDesigns> _shared_designs;
+    std::shared_ptr<const CoefficientTable> _coefficient_table;
+    std::array<BiquadCoefficients, MAX_FILTER_SECTIONS> _coefficients;
+    SeqLock<ResponseSnapshot> _response;
+    double _sample_rate = 44100.0;
+
+    // One oversampler per factor (2x, 4x, 8x), all allocated in prepareToPlay
+    // so switching factor doesn't allocate. Only the set for the precision
+    // the host asked for is allocated.
+    //
+    // The processing mode (oversampling, topology, phase, FIR length) is only
+    // ever changed on the message thread, by prepareToPlay or
+    // handleAsyncUpdate with the callback lock held, so the audio thread
+    // always runs a completely prepared mode.
+    Oversamplers<float> _oversamplers;
+    Oversamplers<double> _double_oversamplers;
+    std::vector<float*> _oversampled_channels;
+    std::vector<double*> _double_oversampled_channels;
+    int _oversampling = 0;
+    bool _double_precision = false;
+    FilterTopology _topology = FilterTopology::transposed_direct_form_2;
+    double _host_sample_rate = 44100.0;
+    int _max_block_size = 0;
+
+    // Linear phase mode replaces the filter bank (and oversampling) with an
+    // FIR kernel designed from the published response. The convolution only
+    // runs in float, so double buffers are converted through
+    // _linear_phase_buffer.
+    LinearPhaseFilter _linear_phase_filter { _response };
+    juce::AudioBuffer<float> _linear_phase_buffer;
+    bool _linear_phase = false;
+    int _fir_length = FIR_LENGTHS[2];
+
+    // Tail in host samples, from the slowest decaying pole plus latency
+    std::atomic<double> _tail_seconds { 0.0 };
+    juce::int64 _tail_samples = 0;
+    juce::int64 _silent_samples = 0;
+    bool _skipping = false;
+    std::atomic<juce::uint64> _skipped_blocks { 0 };
+
+    SpectrumAnalyzer _analyzer;
+    FilterBank _filter_bank;
+    AudioThreadMonitor _monitor;
+
+    // Started in prepareToPlay for wide buses whatever the mode, so switching
+    // it on never creates threads on the audio thread. Idle workers park.
+    ChannelWorkers _workers;
+
+    // Dynamic modes move boost/cut or fc with the level of the input or the
+    // sidechain. The envelope of each host sample of the current chunk is in
+    // _envelope_levels, and every coefficient update reads it at the end of
+    // its sub-block.
+    EnvelopeFollower _envelope_follower;
+    std::vector<float> _envelope_levels;
+    int _envelope_length = 0;
+    int _dynamic_mode = 0;
+    float _dynamic_gain = 0.0f;
+
+    // Hosts may save the state from any thread, so the bank and the current
+    // program are only touched under the lock
+    juce::CriticalSection _programs_lock;
+    std::array<Program, NUM_PROGRAMS> _programs;
+    int _current_program = 0;
+
+    // A program change or state restore crossfades from the old settings,
+    // still running with their state on _fade_bank, to the new ones.
+    std::atomic<bool> _crossfade_pending { false };
+    FilterBank _fade_bank;
+    juce::AudioBuffer<double> _crossfade_buffer;
+    int _crossfade_length = 1;
+    int _crossfade_remaining = 0;
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterPluginAudioProcessor)
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+namespace
+{
+    constexpr int STATE_MAGIC = 0x54535046; // "FPST" read as little endian
+    constexpr int STATE_VERSION = 1;
+    const juce::Identifier STATE_VERSION_ID { "state_version" };
+}
+
+//==============================================================================
+// Plugin state as the host stores it: a magic number, the format version and
+// the ValueTree in JUCE's compact binary encoding. Hosts restore this in one
+// go instead of setting every parameter on its own. readState also accepts
+// XML, either wrapped by AudioProcessor::copyXmlToBinary or as plain text,
+// for hand-edited states and anything saved as XML. The version is stored in
+// the tree too, so it survives a round trip through XML. States written by a
+// newer format version are refused, whichever way they are encoded: what
+// their properties mean may have changed.
+inline void writeState(juce::ValueTree state, juce::MemoryBlock& destData)
+{
+    state.setProperty(STATE_VERSION_ID, STATE_VERSION, nullptr);
+
+    juce::MemoryOutputStream stream(destData, false);
+    stream.writeInt(STATE_MAGIC);
+    stream.writeInt(STATE_VERSION);
+    state.writeToStream(stream);
+}
+
+// An invalid tree in place of one from a newer format version.
+inline juce::ValueTree ifKnownVersion(juce::ValueTree state)
+{
+    if (static_cast<int>(state.getProperty(STATE_VERSION_ID, STATE_VERSION)) > STATE_VERSION)
+        return {};
+    return state;
+}
+
+// Returns an invalid tree if the data is neither format, or newer.
+inline juce::ValueTree readState(const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes <= 0)
+        return {};
+
+    juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+    if (sizeInBytes >= 8 && stream.readInt() == STATE_MAGIC)
+    {
+        if (stream.readInt() > STATE_VERSION)
+            return {};
+        return ifKnownVersion(juce::ValueTree::readFromStream(stream));
+    }
+
+    if (auto xml = juce::AudioProcessor::getXmlFromBinary(data, sizeInBytes))
+        return ifKnownVersion(juce::ValueTree::fromXml(*xml));
+
+    if (auto xml = juce::parseXML(juce::String::fromUTF8(static_cast<const char*>(data), sizeInBytes)))
+        return ifKnownVersion(juce::ValueTree::fromXml(*xml));
+
+    return {};
+}
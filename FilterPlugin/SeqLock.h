@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+//==============================================================================
+// Single-writer sequence lock around a small trivially copyable value. The
+// writer (the audio thread) never waits; readers retry if they overlapped a
+// write. The payload is stored as relaxed atomic words so concurrent reads
+// are well defined.
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+public:
+    SeqLock()
+    {
+        store(T());
+        _sequence.store(0, std::memory_order_relaxed);
+    }
+
+    void store(const T& value) noexcept
+    {
+        std::array<std::uint64_t, NUM_WORDS> words {};
+        std::memcpy(words.data(), &value, sizeof(T));
+
+        const auto sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < NUM_WORDS; ++i)
+        {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T load() const noexcept
+    {
+        std::array<std::uint64_t, NUM_WORDS> words;
+        for (;;)
+        {
+            const auto before = _sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            for (size_t i = 0; i < NUM_WORDS; ++i)
+            {
+                words[i] = _words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_sequence.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        T value;
+        std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+        return value;
+    }
+
+    // Number of completed stores.
+    unsigned int getVersion() const noexcept
+    {
+        return _sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static constexpr size_t NUM_WORDS = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    std::atomic<unsigned int> _sequence { 0 };
+    std::array<std::atomic<std::uint64_t>, NUM_WORDS> _words {};
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <juce_events/juce_events.h>
+
+#include "BiquadKernels.h"
+#include "CoefficientTable.h"
+
+namespace
+{
+    // Slots of the design cache, direct mapped. A session's worth of distinct
+    // settled settings fits many times over.
+    constexpr size_t DESIGN_CACHE_SLOTS = 1024;
+}
+
+// Everything a FilterDesigner result depends on; the remaining rubdsp
+// parameters always keep their defaults.
+struct DesignKey
+{
+    int algorithm = 0;
+    double fc = 1000.0;
+    double Q = 0.707;
+    double boost_cut = 0.0;
+    double sample_rate = 44100.0;
+};
+
+//==============================================================================
+// Filter designs shared by every instance in the process, held through a
+// juce::SharedResourcePointer so it lives as long as any instance does.
+//
+// Coefficient tables are built once per sample rate on a background thread,
+// only when an instance asks for one, and handed out as immutable
+// shared_ptrs. The lock around them is only held to look a table up or to
+// insert a finished one, never while building.
+//
+// Exact designs of settled settings, never the steps of a glide, go into a
+// fixed-size hash table that any thread, the audio threads included, can read
+// and fill without locking: every slot is its own sequence lock, a reader
+// that overlaps a write just misses, and a writer that finds the slot busy
+// drops its result instead of waiting.
+class SharedDesigns : private juce::Thread
+{
+public:
+    SharedDesigns() : juce::Thread("Coefficient table builder")
+    {
+    }
+
+    ~SharedDesigns() override
+    {
+        // A build can't be interrupted, give one time to finish
+        signalThreadShouldExit();
+        notify();
+        stopThread(10000);
+    }
+
+    // Any thread, never waits for a build. The table for the rate if it has
+    // been built, else null.
+    std::shared_ptr<const CoefficientTable> findTable(double sampleRate)
+    {
+        std::lock_guard<std::mutex> lock(_tables_mutex);
+        auto it = _tables.find(sampleRate);
+        if (it == _tables.end())
+            return nullptr;
+        it->second.fetched = true;
+        return it->second.table;
+    }
+
+    // Message thread. Has the table for the rate built in the background
+    // unless it exists already, and triggers ready once findTable has it.
+    void requestTable(double sampleRate, juce::AsyncUpdater& ready)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_tables_mutex);
+            if (_tables.count(sampleRate) != 0)
+            {
+                ready.triggerAsyncUpdate();
+                return;
+            }
+
+            const std::pair<double, juce::AsyncUpdater*> request { sampleRate, &ready };
+            if (std::find(_requests.begin(), _requests.end(), request) == _requests.end())
+                _requests.push_back(request);
+        }
+
+        if (!isThreadRunning())
+            startThread();
+        notify();
+    }
+
+    // Message thread, before ready goes away. No trigger arrives after this.
+    void cancelRequests(juce::AsyncUpdater& ready)
+    {
+        std::lock_guard<std::mutex> lock(_tables_mutex);
+        _requests.erase(std::remove_if(_requests.begin(), _requests.end(),
+                                       [&ready](const auto& request) { return request.second == &ready; }),
+                        _requests.end());
+    }
+
+    // Any thread. Returns false if the design isn't cached.
+    bool find(const DesignKey& key, BiquadCoefficients& coefficients) const
+    {
+        const auto words = toWords(key);
+        const auto& slot = _slots[indexOf(words)];
+
+        const auto before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            return false;
+
+        std::array<std::uint64_t, NUM_WORDS> stored;
+        for (size_t i = 0; i < NUM_WORDS; ++i)
+        {
+            stored[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != before)
+            return false;
+
+        if (before == 0 || std::memcmp(stored.data(), words.data(), NUM_KEY_WORDS * sizeof(std::uint64_t)) != 0)
+            return false;
+
+        std::memcpy(static_cast<void*>(&coefficients), stored.data() + NUM_KEY_WORDS, sizeof(BiquadCoefficients));
+        return true;
+    }
+
+    // Any thread. Never waits; the design is dropped if its slot is being
+    // written by someone else.
+    void insert(const DesignKey& key, const BiquadCoefficients& coefficients)
+    {
+        auto words = toWords(key);
+        std::memcpy(words.data() + NUM_KEY_WORDS, &coefficients, sizeof(BiquadCoefficients));
+        auto& slot = _slots[indexOf(words)];
+
+        auto sequence = slot.sequence.load(std::memory_order_relaxed);
+        if ((sequence & 1) || !slot.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_relaxed))
+            return;
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < NUM_WORDS; ++i)
+        {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+private:
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            double sample_rate = 0.0;
+            {
+                std::lock_guard<std::mutex> lock(_tables_mutex);
+                if (!_requests.empty())
+                    sample_rate = _requests.front().first;
+            }
+            if (sample_rate <= 0.0)
+            {
+                wait(-1);
+                continue;
+            }
+
+            auto table = std::make_shared<CoefficientTable>();
+            table->build(sample_rate);
+
+            std::lock_guard<std::mutex> lock(_tables_mutex);
+
+            // Drop the rates no instance runs at any more. One nobody has
+            // fetched yet is kept, its requester is only about to.
+            for (auto it = _tables.begin(); it != _tables.end();)
+            {
+                if (it->second.fetched && it->second.table.use_count() == 1)
+                    it = _tables.erase(it);
+                else
+                    ++it;
+            }
+            _tables[sample_rate] = { std::move(table), false };
+
+            for (auto it = _requests.begin(); it != _requests.end();)
+            {
+                if (it->first == sample_rate)
+                {
+                    it->second->triggerAsyncUpdate();
+                    it = _requests.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    static constexpr size_t NUM_KEY_WORDS = 5;
+    static constexpr size_t NUM_WORDS = NUM_KEY_WORDS + sizeof(BiquadCoefficients) / sizeof(std::uint64_t);
+
+    using Words = std::array<std::uint64_t, NUM_WORDS>;
+
+    struct Slot
+    {
+        // Even when stable, odd while being written, 0 if never written
+        std::atomic<std::uint32_t> sequence { 0 };
+        std::array<std::atomic<std::uint64_t>, NUM_WORDS> words {};
+    };
+
+    static Words toWords(const DesignKey& key)
+    {
+        Words words {};
+        words[0] = static_cast<std::uint64_t>(key.algorithm);
+        std::memcpy(&words[1], &key.fc, sizeof(double));
+        std::memcpy(&words[2], &key.Q, sizeof(double));
+        std::memcpy(&words[3], &key.boost_cut, sizeof(double));
+        std::memcpy(&words[4], &key.sample_rate, sizeof(double));
+        return words;
+    }
+
+    static size_t indexOf(const Words& words)
+    {
+        std::uint64_t hash = 0;
+        for (size_t i = 0; i < NUM_KEY_WORDS; ++i)
+        {
+            // splitmix64 finaliser over the running hash
+            hash += words[i] + 0x9e3779b97f4a7c15ull;
+            hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+            hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+            hash ^= hash >> 31;
+        }
+        return static_cast<size_t>(hash % DESIGN_CACHE_SLOTS);
+    }
+
+    struct TableEntry
+    {
+        std::shared_ptr<const CoefficientTable> table;
+        bool fetched = false;
+    };
+
+    // Both only under the mutex. Requests are served oldest first.
+    std::mutex _tables_mutex;
+    std::map<double, TableEntry> _tables;
+    std::vector<std::pair<double, juce::AsyncUpdater*>> _requests;
+    std::array<Slot, DESIGN_CACHE_SLOTS> _slots;
+};
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include <juce_dsp/juce_dsp.h>
+
+namespace
+{
+    constexpr int ANALYZER_FFT_ORDER = 11;
+    constexpr int ANALYZER_FFT_SIZE = 1 << ANALYZER_FFT_ORDER;
+    constexpr int ANALYZER_NUM_BINS = ANALYZER_FFT_SIZE / 2;
+    constexpr int ANALYZER_HOP_SIZE = ANALYZER_FFT_SIZE / 4;
+    constexpr int ANALYZER_FIFO_SIZE = ANALYZER_FFT_SIZE * 4;
+    constexpr float ANALYZER_MIN_DB = -120.0f;
+    constexpr float ANALYZER_AVERAGING = 0.8f;
+    constexpr float ANALYZER_PEAK_DECAY_DB = 0.5f;
+}
+
+//==============================================================================
+// Spectrum of the plugin's input and output for the editor. The audio thread
+// only mixes each block down to mono and writes it into a lock-free
+// single-producer/single-consumer FIFO, and only while an editor has the
+// analyzer active. Windowing, the overlapping FFTs, averaging and peak hold
+// all run on the analyzer's own background thread.
+class SpectrumAnalyzer : private juce::Thread
+{
+public:
+    enum Stream
+    {
+        input = 0,
+        output,
+        num_streams
+    };
+
+    struct Frame
+    {
+        std::array<float, ANALYZER_NUM_BINS> average;
+        std::array<float, ANALYZER_NUM_BINS> peak;
+    };
+
+    SpectrumAnalyzer() : juce::Thread("Spectrum analyzer"),
+                         _fft(ANALYZER_FFT_ORDER),
+                         _window(ANALYZER_FFT_SIZE, juce::dsp::WindowingFunction<float>::hann, true)
+    {
+        for (auto& frame : _published)
+        {
+            frame.average.fill(ANALYZER_MIN_DB);
+            frame.peak.fill(ANALYZER_MIN_DB);
+        }
+    }
+
+    ~SpectrumAnalyzer() override
+    {
+        stopThread(1000);
+    }
+
+    void prepare(double sampleRate)
+    {
+        _sample_rate = sampleRate;
+    }
+
+    double getSampleRate() const
+    {
+        return _sample_rate.load();
+    }
+
+    // Message thread: start analysing when an editor opens, stop when it closes.
+    void setActive(bool active)
+    {
+        if (active)
+        {
+            _active = true;
+            startThread();
+        }
+        else
+        {
+            _active = false;
+            stopThread(1000);
+        }
+    }
+
+    // Audio thread: wait-free, returns straight away when nobody is looking.
+    // Double precision input is analysed at float precision.
+    template <typename SampleType>
+    void push(Stream stream, const SampleType* const* channels, int numChannels, int numSamples)
+    {
+        if (!_active.load(std::memory_order_relaxed) || numChannels <= 0)
+            return;
+
+        auto& state = _streams[stream];
+        int start1, size1, start2, size2;
+        state.fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+        const float gain = 1.0f / numChannels;
+        mixDown(channels, numChannels, 0, state.ring.data() + start1, size1, gain);
+        mixDown(channels, numChannels, size1, state.ring.data() + start2, size2, gain);
+        state.fifo.finishedWrite(size1 + size2);
+    }
+
+    // Bumped for every new analysed frame.
+    unsigned int getFrameVersion() const
+    {
+        return _frame_version.load();
+    }
+
+    void getFrame(Stream stream, Frame& frame) const
+    {
+        const juce::SpinLock::ScopedLockType lock(_frame_lock);
+        frame = _published[stream];
+    }
+
+private:
+    struct StreamState
+    {
+        juce::AbstractFifo fifo { ANALYZER_FIFO_SIZE };
+        std::vector<float> ring = std::vector<float>(ANALYZER_FIFO_SIZE, 0.0f);
+        std::vector<float> history = std::vector<float>(ANALYZER_FFT_SIZE, 0.0f);
+        int history_position = 0;
+        int samples_until_hop = ANALYZER_HOP_SIZE;
+        Frame frame;
+
+        // Consumer side only: the FIFO is emptied by reading past whatever the
+        // audio thread left in it, never reset under the producer.
+        void reset()
+        {
+            fifo.finishedRead(fifo.getNumReady());
+            std::fill(history.begin(), history.end(), 0.0f);
+            history_position = 0;
+            samples_until_hop = ANALYZER_HOP_SIZE;
+            frame.average.fill(ANALYZER_MIN_DB);
+            frame.peak.fill(ANALYZER_MIN_DB);
+        }
+    };
+
+    static void mixDown(const float* const* channels, int numChannels, int offset, float* destination, int numSamples, float gain)
+    {
+        if (numSamples <= 0)
+            return;
+
+        juce::FloatVectorOperations::copyWithMultiply(destination, channels[0] + offset, gain, numSamples);
+        for (int channel = 1; channel < numChannels; ++channel)
+        {
+            juce::FloatVectorOperations::addWithMultiply(destination, channels[channel] + offset, gain, numSamples);
+        }
+    }
+
+    static void mixDown(const double* const* channels, int numChannels, int offset, float* destination, int numSamples, float gain)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            double sum = 0.0;
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                sum += channels[channel][offset + i];
+            }
+            destination[i] = static_cast<float>(sum) * gain;
+        }
+    }
+
+    void run() override
+    {
+        // Start from silence rather than whatever was left over from the last
+        // time an editor was open
+        for (auto& state : _streams)
+        {
+            state.reset();
+        }
+
+        while (!threadShouldExit())
+        {
+            bool new_frame = false;
+            for (int stream = 0; stream < num_streams; ++stream)
+            {
+                new_frame |= readStream(_streams[stream]);
+            }
+
+            if (new_frame)
+            {
+                {
+                    const juce::SpinLock::ScopedLockType lock(_frame_lock);
+                    for (int stream = 0; stream < num_streams; ++stream)
+                    {
+                        _published[stream] = _streams[stream].frame;
+                    }
+                }
+                ++_frame_version;
+            }
+            else
+            {
+                wait(10);
+            }
+        }
+    }
+
+    bool readStream(StreamState& state)
+    {
+        bool new_frame = false;
+        int start1, size1, start2, size2;
+        state.fifo.prepareToRead(state.fifo.getNumReady(), start1, size1, start2, size2);
+
+        for (auto [start, size] : { std::make_pair(start1, size1), std::make_pair(start2, size2) })
+        {
+            for (int i = 0; i < size; ++i)
+            {
+                state.history[state.history_position] = state.ring[start + i];
+                state.history_position = (state.history_position + 1) % ANALYZER_FFT_SIZE;
+
+                if (--state.samples_until_hop == 0)
+                {
+                    state.samples_until_hop = ANALYZER_HOP_SIZE;
+                    analyse(state);
+                    new_frame = true;
+                }
+            }
+        }
+
+        state.fifo.finishedRead(size1 + size2);
+        return new_frame;
+    }
+
+    void analyse(StreamState& state)
+    {
+        // Unroll the circular history, oldest sample first
+        const int tail = ANALYZER_FFT_SIZE - state.history_position;
+        std::copy(state.history.begin() + state.history_position, state.history.end(), _fft_data.begin());
+        std::copy(state.history.begin(), state.history.begin() + state.history_position, _fft_data.begin() + tail);
+        std::fill(_fft_data.begin() + ANALYZER_FFT_SIZE, _fft_data.end(), 0.0f);
+
+        _window.multiplyWithWindowingTable(_fft_data.data(), ANALYZER_FFT_SIZE);
+        _fft.performFrequencyOnlyForwardTransform(_fft_data.data());
+
+        const float scale = 2.0f / ANALYZER_FFT_SIZE;
+        for (int bin = 0; bin < ANALYZER_NUM_BINS; ++bin)
+        {
+            const float level = juce::Decibels::gainToDecibels(_fft_data[bin] * scale, ANALYZER_MIN_DB);
+            auto& average = state.frame.average[bin];
+            auto& peak = state.frame.peak[bin];
+            average = ANALYZER_AVERAGING * average + (1.0f - ANALYZER_AVERAGING) * level;
+            peak = std::max(peak - ANALYZER_PEAK_DECAY_DB, level);
+        }
+    }
+
+    std::atomic<bool> _active { false };
+    std::atomic<double> _sample_rate { 44100.0 };
+    std::array<StreamState, num_streams> _streams;
+
+    juce::dsp::FFT _fft;
+    juce::dsp::WindowingFunction<float> _window;
+    std::array<float, 2 * ANALYZER_FFT_SIZE> _fft_data {};
+
+    mutable juce::SpinLock _frame_lock;
+    std::array<Frame, num_streams> _published;
+    std::atomic<unsigned int> _frame_version { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumAnalyzer)
+};
@@ -0,0 +1,130 @@
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+//==============================================================================
+MultibandEQAudioProcessorEditor::MultibandEQAudioProcessorEditor (MultibandEQAudioProcessor& p)
+    : AudioProcessorEditor (&p), processorRef (p), _freq_plot(p)
+{
+    double ratio = 4.0/3.0;
+    setResizeLimits(500, 500/ratio, 1200, 1200/ratio);
+    getConstrainer()->setFixedAspectRatio(ratio);
+    setSize(500.0,500.0/ratio);
+
+    // Band selector
+    addAndMakeVisible(_band_combo_box);
+    for (int band = 0; band < NUM_EQ_BANDS; ++band)
+    {
+        _band_combo_box.addItem("Band " + juce::String(band + 1), band + 1);
+    }
+    _band_combo_box.onChange = [this] { selectBand(_band_combo_box.getSelectedId() - 1); };
+
+    addAndMakeVisible(_band_combo_box_label);
+    _band_combo_box_label.setText("Band", juce::dontSendNotification);
+    _band_combo_box_label.attachToComponent(&_band_combo_box, false);
+    _band_combo_box_label.setJustificationType(juce::Justification::centred);
+
+    addAndMakeVisible(_enabled_button);
+
+    // type combo box
+    addAndMakeVisible(_filter_type_combo_box);
+    for (int algo_idx = 0; algo_idx < rubdsp::filterAlgorithm::NUM_ALGROITHMS; ++algo_idx)
+    {
+        _filter_type_combo_box.addItem(rubdsp::filterAlgorithmStrings[algo_idx], algo_idx + 1);
+    }
+
+    addAndMakeVisible(_filter_type_combo_box_label);
+    _filter_type_combo_box_label.setText("Filter type", juce::dontSendNotification);
+    _filter_type_combo_box_label.attachToComponent(&_filter_type_combo_box, false);
+    _filter_type_combo_box_label.setJustificationType(juce::Justification::centred);
+
+    setupSlider(_cutoff_slider, _cutoff_slider_label, "Frequency", " Hz");
+    setupSlider(_Q_slider, _Q_slider_label, "Q", "");
+    setupSlider(_boost_cut_slider, _boost_cut_slider_label, "Boost/Cut", " dB");
+
+    // Frequency plot
+    addAndMakeVisible(_freq_plot);
+
+    _band_combo_box.setSelectedId(1);
+}
+
+MultibandEQAudioProcessorEditor::~MultibandEQAudioProcessorEditor()
+{
+}
+
+//==============================================================================
+void MultibandEQAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    // (Our component is opaque, so we must completely fill the background with a solid colour)
+    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
+}
+
+void MultibandEQAudioProcessorEditor::resized()
+{
+    float margin = 0.01f;
+    int component_box = (getWidth() - 6.0f * margin * getHeight()) / 5.0f;
+    auto bounds = getLocalBounds();
+    bounds.reduce(margin*getHeight(), margin*getHeight());
+    _freq_plot.setBounds(bounds.removeFromTop(bounds.getHeight() - component_box - 20));
+
+    auto band_box = bounds.removeFromLeft(component_box).reduced(margin * getHeight(), margin * getHeight());
+    band_box.removeFromTop(20);
+    _band_combo_box.setBounds(band_box.removeFromTop(component_box / 4));
+    _enabled_button.setBounds(band_box.removeFromTop(component_box / 4));
+    bounds.removeFromLeft(margin * getHeight());
+
+    auto filter_type_box = bounds.removeFromLeft(component_box).reduced(margin * getHeight(), margin * getHeight());
+    filter_type_box.removeFromTop(20);
+    _filter_type_combo_box.setBounds(filter_type_box.removeFromTop(component_box / 4));
+    bounds.removeFromLeft(margin * getHeight());
+
+    for (auto* slider : { &_cutoff_slider, &_Q_slider, &_boost_cut_slider })
+    {
+        auto slider_box = bounds.removeFromLeft(component_box).reduced(margin * getHeight(), margin * getHeight());
+        slider_box.removeFromTop(20);
+        slider->setBounds(slider_box);
+        bounds.removeFromLeft(margin * getHeight());
+    }
+}
+
+void MultibandEQAudioProcessorEditor::setupSlider(juce::Slider& slider,
+                                                  juce::Label& label,
+                                                  const std::string& text,
+                                                  const std::string& suffix)
+{
+    addAndMakeVisible(slider);
+    slider.setTextValueSuffix(suffix);
+    slider.setSliderStyle(juce::Slider::SliderStyle::RotaryVerticalDrag);
+    slider.setTextBoxStyle(juce::Slider::TextBoxBelow, true, 80, 20);
+
+    addAndMakeVisible(label);
+    label.setText(text, juce::dontSendNotification);
+    label.attachToComponent(&slider, false);
+    label.setJustificationType(juce::Justification::centred);
+}
+
+void MultibandEQAudioProcessorEditor::selectBand(int band)
+{
+    if (band < 0)
+        return;
+
+    // The attachments take their range and value from the parameter, so
+    // re-creating them is all it takes to point the controls at another band.
+    auto& state = *processorRef.getParameterState();
+    _enabled_button_attachment.reset();
+    _filter_type_combo_box_attachment.reset();
+    _cutoff_slider_attachment.reset();
+    _Q_slider_attachment.reset();
+    _boost_cut_slider_attachment.reset();
+
+    using State = juce::AudioProcessorValueTreeState;
+    _enabled_button_attachment = std::make_unique<State::ButtonAttachment>(
+        state, MultibandEQAudioProcessor::getBandParameterID(band, "enabled"), _enabled_button);
+    _filter_type_combo_box_attachment = std::make_unique<State::ComboBoxAttachment>(
+        state, MultibandEQAudioProcessor::getBandParameterID(band, "filter_type"), _filter_type_combo_box);
+    _cutoff_slider_attachment = std::make_unique<State::SliderAttachment>(
+        state, MultibandEQAudioProcessor::getBandParameterID(band, "fc"), _cutoff_slider);
+    _Q_slider_attachment = std::make_unique<State::SliderAttachment>(
+        state, MultibandEQAudioProcessor::getBandParameterID(band, "Q"), _Q_slider);
+    _boost_cut_slider_attachment = std::make_unique<State::SliderAttachment>(
+        state, MultibandEQAudioProcessor::getBandParameterID(band, "boost_cut"), _boost_cut_slider);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+
+#include "PluginProcessor.h"
+#include "../FilterPlugin/FrequencyPlot.h"
+
+//==============================================================================
+// Combined response of all bands on top, and one set of controls below that
+// is attached to whichever band is selected.
+class MultibandEQAudioProcessorEditor  : public juce::AudioProcessorEditor
+{
+public:
+    explicit MultibandEQAudioProcessorEditor (MultibandEQAudioProcessor&);
+    ~MultibandEQAudioProcessorEditor() override;
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+    void resized() override;
+    void setupSlider(juce::Slider& slider, juce::Label& label, const std::string& text, const std::string& suffix);
+
+private:
+    void selectBand(int band);
+
+    // This reference is provided as a quick way for your editor to
+    // access the processor object that created it.
+    MultibandEQAudioProcessor& processorRef;
+
+    juce::ComboBox _band_combo_box;
+    juce::Label _band_combo_box_label;
+
+    juce::ToggleButton _enabled_button { "Enabled" };
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> _enabled_button_attachment;
+
+    juce::ComboBox _filter_type_combo_box;
+    juce::Label _filter_type_combo_box_label;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> _filter_type_combo_box_attachment;
+
+    juce::Slider _cutoff_slider;
+    juce::Label _cutoff_slider_label;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> _cutoff_slider_attachment;
+
+    juce::Slider _Q_slider;
+    juce::Label _Q_slider_label;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> _Q_slider_attachment;
+
+    juce::Slider _boost_cut_slider;
+    juce::Label _boost_cut_slider_label;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> _boost_cut_slider_attachment;
+
+    FrequencyPlot<MultibandEQAudioProcessor> _freq_plot;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MultibandEQAudioProcessorEditor)
+};
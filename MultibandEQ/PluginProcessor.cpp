@@ -0,0 +1,336 @@
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+//==============================================================================
+MultibandEQAudioProcessor::MultibandEQAudioProcessor()
+     : AudioProcessor (BusesProperties()
+                     #if ! JucePlugin_IsMidiEffect
+                      #if ! JucePlugin_IsSynth
+                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                      #endif
+                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                     #endif
+                       ),
+    _parameters(*this, nullptr, juce::Identifier("MultibandEQ"), createParameterLayout())
+{
+    for (int i = 0; i < NUM_EQ_BANDS; ++i)
+    {
+        auto& band = _bands[static_cast<size_t>(i)];
+        band.enabled_parameter = _parameters.getRawParameterValue(getBandParameterID(i, "enabled"));
+        band.filter_type_parameter = _parameters.getRawParameterValue(getBandParameterID(i, "filter_type"));
+        band.fc_parameter = _parameters.getRawParameterValue(getBandParameterID(i, "fc"));
+        band.Q_parameter = _parameters.getRawParameterValue(getBandParameterID(i, "Q"));
+        band.boost_cut_parameter = _parameters.getRawParameterValue(getBandParameterID(i, "boost_cut"));
+    }
+}
+
+MultibandEQAudioProcessor::~MultibandEQAudioProcessor()
+{
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout MultibandEQAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    for (int i = 0; i < NUM_EQ_BANDS; ++i)
+    {
+        auto name = "Band " + juce::String(i + 1) + " ";
+        layout.add(std::make_unique<juce::AudioParameterBool> (getBandParameterID(i, "enabled"), name + "Enabled", false),
+                   std::make_unique<juce::AudioParameterInt> (getBandParameterID(i, "filter_type"), name + "Filter Type",
+                                                              0, rubdsp::filterAlgorithm::NUM_ALGROITHMS - 1, 1),
+                   std::make_unique<juce::AudioParameterFloat> (getBandParameterID(i, "fc"), name + "Frequency",
+                                                                juce::NormalisableRange<float>(10.0f, 20000.0f, 0.0f, 0.25f),
+                                                                EQ_DEFAULT_FREQUENCIES[i]),
+                   std::make_unique<juce::AudioParameterFloat> (getBandParameterID(i, "Q"), name + "Q", 0.1f, 10.0f, 1.0f),
+                   std::make_unique<juce::AudioParameterFloat> (getBandParameterID(i, "boost_cut"), name + "Boost/Cut", -24.0f, 24.0f, 0.0f));
+    }
+    return layout;
+}
+
+//==============================================================================
+const juce::String MultibandEQAudioProcessor::getName() const
+{
+    return JucePlugin_Name;
+}
+
+bool MultibandEQAudioProcessor::acceptsMidi() const
+{
+   #if JucePlugin_WantsMidiInput
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+bool MultibandEQAudioProcessor::producesMidi() const
+{
+   #if JucePlugin_ProducesMidiOutput
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+bool MultibandEQAudioProcessor::isMidiEffect() const
+{
+   #if JucePlugin_IsMidiEffect
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+double MultibandEQAudioProcessor::getTailLengthSeconds() const
+{
+    return _tail_seconds.load();
+}
+
+int MultibandEQAudioProcessor::getNumPrograms()
+{
+    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
+                // so this should be at least 1, even if you're not really implementing programs.
+}
+
+int MultibandEQAudioProcessor::getCurrentProgram()
+{
+    return 0;
+}
+
+void MultibandEQAudioProcessor::setCurrentProgram (int index)
+{
+    juce::ignoreUnused (index);
+}
+
+const juce::String MultibandEQAudioProcessor::getProgramName (int index)
+{
+    juce::ignoreUnused (index);
+    return {};
+}
+
+void MultibandEQAudioProcessor::changeProgramName (int index, const juce::String& newName)
+{
+    juce::ignoreUnused (index, newName);
+}
+
+//==============================================================================
+void MultibandEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    juce::ignoreUnused (samplesPerBlock);
+    _sample_rate = sampleRate;
+    _designer.reset(sampleRate);
+    _analyzer.prepare(sampleRate);
+    _filter_bank.prepare(getMainBusNumOutputChannels(), NUM_EQ_BANDS);
+
+    for (int i = 0; i < NUM_EQ_BANDS; ++i)
+    {
+        auto& band = _bands[static_cast<size_t>(i)];
+        band.enabled = band.enabled_parameter->load() > 0.5f;
+        band.filter_type = static_cast<int>(band.filter_type_parameter->load());
+        band.fc.reset(sampleRate, EQ_SMOOTHING_TIME_SECONDS);
+        band.fc.setCurrentAndTargetValue(band.fc_parameter->load());
+        band.Q.reset(sampleRate, EQ_SMOOTHING_TIME_SECONDS);
+        band.Q.setCurrentAndTargetValue(band.Q_parameter->load());
+        band.boost_cut.reset(sampleRate, EQ_SMOOTHING_TIME_SECONDS);
+        band.boost_cut.setCurrentAndTargetValue(band.boost_cut_parameter->load());
+        band.dirty = true;
+        _filter_bank.setSectionActive(i, band.enabled);
+    }
+
+    _response_dirty = true;
+    _samples_until_update = 0;
+    updateBands(0);
+}
+
+void MultibandEQAudioProcessor::releaseResources()
+{
+    // When playback stops, you can use this as an opportunity to free up any
+    // spare memory, etc.
+}
+
+bool MultibandEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
+{
+  #if JucePlugin_IsMidiEffect
+    juce::ignoreUnused (layouts);
+    return true;
+  #else
+    if (layouts.getMainOutputChannelSet().isDisabled())
+        return false;
+
+    // This checks if the input layout matches the output layout
+   #if ! JucePlugin_IsSynth
+    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+        return false;
+   #endif
+
+    return true;
+  #endif
+}
+
+void MultibandEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
+                                              juce::MidiBuffer& midiMessages)
+{
+    juce::ignoreUnused (midiMessages);
+
+    juce::ScopedNoDenormals noDenormals;
+    auto totalNumInputChannels  = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
+
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear (i, 0, buffer.getNumSamples());
+
+    readBands();
+
+    auto channels = buffer.getArrayOfWritePointers();
+    auto num_samples = buffer.getNumSamples();
+    _analyzer.push(SpectrumAnalyzer::input, channels, totalNumOutputChannels, num_samples);
+
+    int position = 0;
+    while (position < num_samples)
+    {
+        if (_samples_until_update == 0)
+        {
+            _samples_until_update = EQ_UPDATE_INTERVAL;
+            updateBands(_samples_until_update);
+        }
+
+        auto chunk = std::min(num_samples - position, _samples_until_update);
+        _filter_bank.process(channels, totalNumOutputChannels, position, chunk);
+        position += chunk;
+        _samples_until_update -= chunk;
+    }
+
+    _analyzer.push(SpectrumAnalyzer::output, channels, totalNumOutputChannels, num_samples);
+}
+
+void MultibandEQAudioProcessor::readBands()
+{
+    for (int i = 0; i < NUM_EQ_BANDS; ++i)
+    {
+        auto& band = _bands[static_cast<size_t>(i)];
+        auto enabled = band.enabled_parameter->load() > 0.5f;
+        if (enabled != band.enabled)
+        {
+            // A band coming back in starts from its current settings rather
+            // than gliding from wherever it was bypassed.
+            band.enabled = enabled;
+            band.fc.setCurrentAndTargetValue(band.fc_parameter->load());
+            band.Q.setCurrentAndTargetValue(band.Q_parameter->load());
+            band.boost_cut.setCurrentAndTargetValue(band.boost_cut_parameter->load());
+            band.dirty = true;
+            _filter_bank.setSectionActive(i, enabled);
+            _response_dirty = true;
+        }
+
+        if (!band.enabled)
+            continue;
+
+        band.fc.setTargetValue(band.fc_parameter->load());
+        band.Q.setTargetValue(band.Q_parameter->load());
+        band.boost_cut.setTargetValue(band.boost_cut_parameter->load());
+
+        auto filter_type = static_cast<int>(band.filter_type_parameter->load());
+        if (filter_type != band.filter_type)
+        {
+            band.filter_type = filter_type;
+            band.dirty = true;
+        }
+    }
+}
+
+void MultibandEQAudioProcessor::updateBands(int numSamples)
+{
+    for (int i = 0; i < NUM_EQ_BANDS; ++i)
+    {
+        auto& band = _bands[static_cast<size_t>(i)];
+        if (!band.enabled)
+            continue;
+
+        auto smoothing = band.fc.isSmoothing() || band.Q.isSmoothing() || band.boost_cut.isSmoothing();
+        if (!smoothing && !band.dirty)
+            continue;
+
+        band.dirty = false;
+        _response_dirty = true;
+
+        // Design for where the smoothers will be at the end of this sub-block
+        const DesignKey key { band.filter_type, band.fc.skip(numSamples), band.Q.skip(numSamples),
+                              band.boost_cut.skip(numSamples), _sample_rate };
+
+        // Only settled designs are shared; the steps of a glide are never
+        // asked for again and would only push those out of the cache
+        const auto settled = !band.fc.isSmoothing() && !band.Q.isSmoothing() && !band.boost_cut.isSmoothing();
+        if (!settled || !_shared_designs->find(key, band.coefficients))
+        {
+            auto parameters = _designer.getParameters();
+            parameters.fc = key.fc;
+            parameters.Q = key.Q;
+            parameters.boost_cut_db = key.boost_cut;
+            parameters.algorithm = static_cast<rubdsp::filterAlgorithm>(key.algorithm);
+            band.coefficients = _designer.design(parameters);
+            if (settled)
+                _shared_designs->insert(key, band.coefficients);
+        }
+        _filter_bank.rampCoefficients(i, band.coefficients, numSamples);
+    }
+
+    if (_response_dirty)
+    {
+        _response_dirty = false;
+        publishResponse();
+    }
+}
+
+void MultibandEQAudioProcessor::publishResponse()
+{
+    EQResponseSnapshot snapshot;
+    snapshot.num_sections = 0;
+    snapshot.sample_rate = _sample_rate;
+    double radius = 0.0;
+    for (const auto& band : _bands)
+    {
+        if (band.enabled)
+        {
+            snapshot.sections[static_cast<size_t>(snapshot.num_sections++)] = band.coefficients;
+            radius = std::max(radius, poleRadius(band.coefficients));
+        }
+    }
+    _response.store(snapshot);
+
+    double tail_seconds = EQ_MAX_TAIL_SECONDS;
+    if (radius < 1.0)
+    {
+        auto decay_samples = radius > 0.0 ? std::log(EQ_TAIL_DECAY) / std::log(radius) : 2.0;
+        tail_seconds = std::min(EQ_MAX_TAIL_SECONDS, decay_samples / _sample_rate);
+    }
+    _tail_seconds = tail_seconds;
+}
+
+//==============================================================================
+bool MultibandEQAudioProcessor::hasEditor() const
+{
+    return true; // (change this to false if you choose to not supply an editor)
+}
+
+juce::AudioProcessorEditor* MultibandEQAudioProcessor::createEditor()
+{
+    return new MultibandEQAudioProcessorEditor (*this);
+}
+
+//==============================================================================
+void MultibandEQAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    writeState(_parameters.copyState(), destData);
+}
+
+void MultibandEQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    auto state = readState(data, sizeInBytes);
+    if (state.hasType(_parameters.state.getType()))
+        _parameters.replaceState(state);
+}
+
+//==============================================================================
+// This creates new instances of the plugin..
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new MultibandEQAudioProcessor();
+}
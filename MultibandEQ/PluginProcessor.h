@@ -0,0 +1,132 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "audio_filter.h"
+#include "../FilterPlugin/FilterBank.h"
+#include "../FilterPlugin/FilterDesigner.h"
+#include "../FilterPlugin/FrequencyResponse.h"
+#include "../FilterPlugin/PluginState.h"
+#include "../FilterPlugin/SeqLock.h"
+#include "../FilterPlugin/SharedDesigns.h"
+#include "../FilterPlugin/SpectrumAnalyzer.h"
+
+namespace
+{
+    constexpr int NUM_EQ_BANDS = 8;
+    constexpr int EQ_UPDATE_INTERVAL = 32;
+    constexpr double EQ_SMOOTHING_TIME_SECONDS = 0.02;
+    constexpr double EQ_TAIL_DECAY = 1.0e-6; // -120 dB
+    constexpr double EQ_MAX_TAIL_SECONDS = 10.0;
+    constexpr float EQ_DEFAULT_FREQUENCIES[NUM_EQ_BANDS] = { 60.0f, 150.0f, 400.0f, 1000.0f, 2500.0f, 5000.0f, 10000.0f, 15000.0f };
+}
+
+using EQResponseSnapshot = BasicResponseSnapshot<NUM_EQ_BANDS>;
+
+//==============================================================================
+// Several rubdsp filters in series in one instance. Every band is one section
+// of a single FilterBank cascade, so the whole EQ runs as one kernel per
+// channel group, and a bypassed band is switched out of the cascade and costs
+// nothing.
+class MultibandEQAudioProcessor  : public juce::AudioProcessor
+{
+public:
+    //==============================================================================
+    MultibandEQAudioProcessor();
+    ~MultibandEQAudioProcessor() override;
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
+    void releaseResources() override;
+
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+
+    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    using AudioProcessor::processBlock;
+
+    //==============================================================================
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override;
+
+    //==============================================================================
+    const juce::String getName() const override;
+
+    bool acceptsMidi() const override;
+    bool producesMidi() const override;
+    bool isMidiEffect() const override;
+    double getTailLengthSeconds() const override;
+
+    //==============================================================================
+    int getNumPrograms() override;
+    int getCurrentProgram() override;
+    void setCurrentProgram (int index) override;
+    const juce::String getProgramName (int index) override;
+    void changeProgramName (int index, const juce::String& newName) override;
+
+    //==============================================================================
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+
+    juce::AudioProcessorValueTreeState* getParameterState() {
+        return &_parameters;
+    }
+
+    // e.g. getBandParameterID(0, "fc") == "band1_fc"
+    static juce::String getBandParameterID(int band, const juce::String& name) {
+        return "band" + juce::String(band + 1) + "_" + name;
+    }
+
+    // Bumped every time any band's coefficients change.
+    unsigned int getResponseVersion() const {
+        return _response.getVersion();
+    }
+
+    // The enabled bands' sections, for drawing the combined response.
+    EQResponseSnapshot getResponseSnapshot() const {
+        return _response.load();
+    }
+
+    SpectrumAnalyzer& getAnalyzer() {
+        return _analyzer;
+    }
+
+private:
+    struct Band
+    {
+        std::atomic<float>* enabled_parameter = nullptr;
+        std::atomic<float>* filter_type_parameter = nullptr;
+        std::atomic<float>* fc_parameter = nullptr;
+        std::atomic<float>* Q_parameter = nullptr;
+        std::atomic<float>* boost_cut_parameter = nullptr;
+
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> fc;
+        juce::SmoothedValue<float> Q;
+        juce::SmoothedValue<float> boost_cut;
+        int filter_type = 1;
+        bool enabled = false;
+        bool dirty = true;
+        BiquadCoefficients coefficients;
+    };
+
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    void readBands();
+    void updateBands(int numSamples);
+    void publishResponse();
+
+    juce::AudioProcessorValueTreeState _parameters;
+    std::array<Band, NUM_EQ_BANDS> _bands;
+    bool _response_dirty = true;
+    int _samples_until_update = 0;
+    double _sample_rate = 44100.0;
+
+    FilterDesigner _designer;
+    juce::SharedResourcePointer<SharedDesigns> _shared_designs;
+    FilterBank _filter_bank;
+    SeqLock<EQResponseSnapshot> _response;
+    SpectrumAnalyzer _analyzer;
+
+    // Until the slowest pole of the enabled bands has decayed by EQ_TAIL_DECAY
+    std::atomic<double> _tail_seconds { 0.0 };
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MultibandEQAudioProcessor)
+};
@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "../FilterPlugin/PluginProcessor.h"
+
+//==============================================================================
+// Offline batch renderer for the FilterPlugin DSP. Streams every input file
+// through its own FilterPluginAudioProcessor in large blocks and writes the
+// result next to it (or into --output-dir), rendering several files at once
+// on a thread pool. Memory use depends on the number of jobs and the block
+// size, never on the length of the files.
+//
+// Usage: FilterRender [--params fc=2000,Q=0.7,...] [--automation <file.json>]
+//                     [--output-dir <dir>] [--suffix <text>] [--block <n>]
+//                     [--jobs <n>] [--tail] <input files...>
+//
+// Parameters take their plain values (Hz, dB, choice index). The automation
+// file is a JSON object from parameter ID to either a value or a list of
+// [seconds, value] breakpoints that are interpolated linearly, e.g.
+//     { "fc": [[0, 200], [10, 8000]], "boost_cut": 6 }
+// The output is aligned with the input (the plugin's latency is removed) and
+// as long as it, or longer by the filter's tail with --tail.
+namespace
+{
+    constexpr int DEFAULT_RENDER_BLOCK_SIZE = 8192;
+    // Automated parameters are updated this often within a block
+    constexpr int AUTOMATION_INTERVAL = 64;
+    const juce::StringArray VALUE_OPTIONS = { "--params", "--automation", "--output-dir", "--suffix", "--block", "--jobs" };
+
+    struct AutomationLane
+    {
+        juce::String parameter_id;
+        std::vector<std::pair<double, float>> points; // (seconds, value), sorted
+
+        float valueAt(double seconds) const
+        {
+            if (seconds <= points.front().first)
+                return points.front().second;
+            if (seconds >= points.back().first)
+                return points.back().second;
+
+            auto next = std::upper_bound(points.begin(), points.end(), seconds,
+                                         [](double t, const std::pair<double, float>& point) { return t < point.first; });
+            auto previous = next - 1;
+            const double alpha = (seconds - previous->first) / (next->first - previous->first);
+            return static_cast<float>(previous->second + alpha * (next->second - previous->second));
+        }
+    };
+
+    struct RenderSettings
+    {
+        juce::StringPairArray parameters;
+        std::vector<AutomationLane> automation;
+        juce::File output_directory;
+        juce::String suffix = "_filtered";
+        int block_size = DEFAULT_RENDER_BLOCK_SIZE;
+        bool tail = false;
+    };
+
+    bool setParameter(FilterPluginAudioProcessor& processor, const juce::String& id, float value)
+    {
+        auto* parameter = processor.getParameterState()->getParameter(id);
+        if (parameter == nullptr)
+            return false;
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        return true;
+    }
+
+    bool parseAutomation(const juce::File& file, std::vector<AutomationLane>& lanes, juce::String& error)
+    {
+        auto json = juce::JSON::parse(file);
+        auto* object = json.getDynamicObject();
+        if (object == nullptr)
+        {
+            error = "Could not parse " + file.getFullPathName();
+            return false;
+        }
+
+        for (auto& property : object->getProperties())
+        {
+            AutomationLane lane;
+            lane.parameter_id = property.name.toString();
+            if (auto* points = property.value.getArray())
+            {
+                for (auto& point : *points)
+                {
+                    if (!point.isArray() || point.size() != 2)
+                    {
+                        error = "Automation points for " + lane.parameter_id + " must be [seconds, value]";
+                        return false;
+                    }
+                    lane.points.emplace_back(static_cast<double>(point[0]), static_cast<float>(point[1]));
+                }
+                std::sort(lane.points.begin(), lane.points.end(),
+                          [](const auto& a, const auto& b) { return a.first < b.first; });
+            }
+            else
+            {
+                lane.points.emplace_back(0.0, static_cast<float>(property.value));
+            }
+
+            if (lane.points.empty())
+            {
+                error = "No automation points for " + lane.parameter_id;
+                return false;
+            }
+            lanes.push_back(std::move(lane));
+        }
+        return true;
+    }
+
+    //==========================================================================
+    // A fixed set of processors shared by the jobs, one per pool thread. The
+    // processors are created on the main thread because their parameter
+    // trees start timers.
+    class ProcessorPool
+    {
+    public:
+        explicit ProcessorPool(int size)
+        {
+            for (int i = 0; i < size; ++i)
+                _free.push_back(std::make_unique<FilterPluginAudioProcessor>());
+        }
+
+        std::unique_ptr<FilterPluginAudioProcessor> acquire()
+        {
+            const juce::ScopedLock lock(_lock);
+            jassert(!_free.empty()); // never more jobs running than processors
+            auto processor = std::move(_free.back());
+            _free.pop_back();
+            return processor;
+        }
+
+        void release(std::unique_ptr<FilterPluginAudioProcessor> processor)
+        {
+            const juce::ScopedLock lock(_lock);
+            _free.push_back(std::move(processor));
+        }
+
+    private:
+        juce::CriticalSection _lock;
+        std::vector<std::unique_ptr<FilterPluginAudioProcessor>> _free;
+    };
+
+    //==========================================================================
+    class RenderJob : public juce::ThreadPoolJob
+    {
+    public:
+        RenderJob(const juce::File& input, const RenderSettings& settings, juce::AudioFormatManager& formats,
+                  ProcessorPool& processors, std::atomic<int>& failures, juce::CriticalSection& outputLock)
+            : juce::ThreadPoolJob(input.getFileName()), _input(input), _settings(settings), _formats(formats),
+              _processors(processors), _failures(failures), _output_lock(outputLock)
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            auto processor = _processors.acquire();
+            juce::String error;
+            const bool rendered = render(*processor, error);
+            processor->releaseResources();
+            _processors.release(std::move(processor));
+
+            const juce::ScopedLock lock(_output_lock);
+            if (rendered)
+            {
+                std::cout << _input.getFileName() << " -> " << _output.getFullPathName() << std::endl;
+            }
+            else
+            {
+                ++_failures;
+                std::cerr << _input.getFileName() << ": " << error << std::endl;
+            }
+            return jobHasFinished;
+        }
+
+    private:
+        bool render(FilterPluginAudioProcessor& processor, juce::String& error)
+        {
+            std::unique_ptr<juce::AudioFormatReader> reader(_formats.createReaderFor(_input));
+            if (reader == nullptr)
+            {
+                error = "unsupported or unreadable file";
+                return false;
+            }
+
+            auto* format = _formats.findFormatForFileExtension(_input.getFileExtension());
+            if (format == nullptr)
+            {
+                error = "no writer for " + _input.getFileExtension() + " files";
+                return false;
+            }
+
+            auto directory = _settings.output_directory == juce::File() ? _input.getParentDirectory() : _settings.output_directory;
+            _output = directory.getChildFile(_input.getFileNameWithoutExtension() + _settings.suffix + _input.getFileExtension());
+            if (_output == _input)
+            {
+                error = "the output would overwrite the input, give a --suffix or an --output-dir";
+                return false;
+            }
+            _output.deleteFile();
+
+            auto bit_depths = format->getPossibleBitDepths();
+            auto bits_per_sample = bit_depths.contains(static_cast<int>(reader->bitsPerSample))
+                                 ? static_cast<int>(reader->bitsPerSample)
+                                 : bit_depths.getLast();
+            auto stream = _output.createOutputStream();
+            if (stream == nullptr)
+            {
+                error = "could not create " + _output.getFullPathName();
+                return false;
+            }
+            std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), reader->sampleRate,
+                                                                                    reader->numChannels, bits_per_sample,
+                                                                                    reader->metadataValues, 0));
+            if (writer == nullptr)
+            {
+                error = "could not write " + format->getFormatName() + " with this channel count and bit depth";
+                return false;
+            }
+            stream.release(); // now owned by the writer
+
+            const auto num_channels = static_cast<int>(reader->numChannels);
+            const auto sample_rate = reader->sampleRate;
+            const auto block_size = _settings.block_size;
+            auto layout = juce::AudioChannelSet::canonicalChannelSet(num_channels);
+            if (layout.isDisabled())
+                layout = juce::AudioChannelSet::discreteChannels(num_channels);
+            juce::AudioProcessor::BusesLayout buses;
+            buses.inputBuses.add(layout);
+            buses.inputBuses.add(juce::AudioChannelSet::disabled()); // sidechain
+            buses.outputBuses.add(layout);
+            if (!processor.setBusesLayout(buses))
+            {
+                error = "unsupported channel count " + juce::String(num_channels);
+                return false;
+            }
+
+            for (auto& key : _settings.parameters.getAllKeys())
+                setParameter(processor, key, _settings.parameters[key].getFloatValue());
+            for (auto& lane : _settings.automation)
+                setParameter(processor, lane.parameter_id, lane.valueAt(0.0));
+
+            processor.setNonRealtime(true);
+            processor.setRateAndBufferSizeDetails(sample_rate, block_size);
+            processor.prepareToPlay(sample_rate, block_size);
+
+            // The tail depends on the settings the input ends with, automation
+            // included, so it is only added once all of the input is through
+            const juce::int64 input_length = reader->lengthInSamples;
+            juce::int64 output_length = input_length;
+            bool tail_pending = _settings.tail;
+            juce::int64 latency_remaining = processor.getLatencySamples();
+
+            juce::AudioBuffer<float> buffer(num_channels, block_size);
+            juce::MidiBuffer midi;
+            juce::int64 read_position = 0;
+            juce::int64 written = 0;
+            while (written < output_length || tail_pending)
+            {
+                if (shouldExit())
+                {
+                    error = "cancelled";
+                    return false;
+                }
+
+                // Past the end of the input the filter rings out on silence
+                const auto available = static_cast<int>(juce::jlimit<juce::int64>(0, block_size, input_length - read_position));
+                if (available > 0 && !reader->read(&buffer, 0, available, read_position, true, true))
+                {
+                    error = "read error";
+                    return false;
+                }
+                if (available < block_size)
+                    buffer.clear(available, block_size - available);
+
+                processWithAutomation(processor, buffer, midi, read_position, sample_rate);
+                read_position += block_size;
+                if (tail_pending && read_position >= input_length)
+                {
+                    tail_pending = false;
+                    output_length += static_cast<juce::int64>(std::ceil(processor.getTailLengthSeconds() * sample_rate));
+                }
+
+                const auto skip = static_cast<int>(std::min<juce::int64>(latency_remaining, block_size));
+                latency_remaining -= skip;
+                const auto count = static_cast<int>(std::min<juce::int64>(block_size - skip, output_length - written));
+                if (count > 0 && !writer->writeFromAudioSampleBuffer(buffer, skip, count))
+                {
+                    error = "write error";
+                    return false;
+                }
+                written += std::max(count, 0);
+            }
+            return true;
+        }
+
+        // Runs one block, in AUTOMATION_INTERVAL steps when anything is automated.
+        void processWithAutomation(FilterPluginAudioProcessor& processor, juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi,
+                          juce::int64 position, double sampleRate)
+        {
+            if (_settings.automation.empty())
+            {
+                processor.processBlock(buffer, midi);
+                return;
+            }
+
+            std::vector<float*> channels(static_cast<size_t>(buffer.getNumChannels()));
+            for (int start = 0; start < buffer.getNumSamples(); start += AUTOMATION_INTERVAL)
+            {
+                const auto seconds = static_cast<double>(position + start) / sampleRate;
+                for (auto& lane : _settings.automation)
+                    setParameter(processor, lane.parameter_id, lane.valueAt(seconds));
+
+                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                    channels[static_cast<size_t>(channel)] = buffer.getWritePointer(channel, start);
+                juce::AudioBuffer<float> step(channels.data(), buffer.getNumChannels(),
+                                              std::min(AUTOMATION_INTERVAL, buffer.getNumSamples() - start));
+                processor.processBlock(step, midi);
+            }
+        }
+
+        juce::File _input;
+        juce::File _output;
+        const RenderSettings& _settings;
+        juce::AudioFormatManager& _formats;
+        ProcessorPool& _processors;
+        std::atomic<int>& _failures;
+        juce::CriticalSection& _output_lock;
+    };
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The parameter tree and its listeners expect a message manager
+    juce::ScopedJuceInitialiser_GUI juce_initialiser;
+
+    juce::ArgumentList arguments(argc, argv);
+
+    // Everything that is neither an option nor an option's value is an input
+    juce::Array<juce::File> inputs;
+    for (int i = 0; i < arguments.size(); ++i)
+    {
+        auto& argument = arguments[i];
+        if (argument.isLongOption())
+        {
+            // "--option value" takes the next argument, "--option=value" doesn't
+            if (!argument.text.containsChar('='))
+            {
+                for (auto& option : VALUE_OPTIONS)
+                {
+                    if (argument.isLongOption(option))
+                    {
+                        ++i;
+                        break;
+                    }
+                }
+            }
+            continue;
+        }
+        inputs.add(argument.resolveAsFile());
+    }
+
+    if (inputs.isEmpty())
+    {
+        std::cerr << "Usage: FilterRender [--params id=value,...] [--automation <file.json>] [--output-dir <dir>]"
+                     " [--suffix <text>] [--block <n>] [--jobs <n>] [--tail] <input files...>" << std::endl;
+        return 1;
+    }
+
+    RenderSettings settings;
+    if (arguments.containsOption("--params"))
+    {
+        for (auto& assignment : juce::StringArray::fromTokens(arguments.getValueForOption("--params"), ",", ""))
+        {
+            if (assignment.trim().isNotEmpty())
+                settings.parameters.set(assignment.upToFirstOccurrenceOf("=", false, false).trim(),
+                                        assignment.fromFirstOccurrenceOf("=", false, false).trim());
+        }
+    }
+    if (arguments.containsOption("--automation"))
+    {
+        juce::String error;
+        if (!parseAutomation(arguments.getFileForOption("--automation"), settings.automation, error))
+        {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    if (arguments.containsOption("--output-dir"))
+    {
+        settings.output_directory = arguments.getFileForOption("--output-dir");
+        if (!settings.output_directory.createDirectory())
+        {
+            std::cerr << "Could not create " << settings.output_directory.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+    if (arguments.containsOption("--suffix"))
+        settings.suffix = arguments.getValueForOption("--suffix");
+    if (arguments.containsOption("--block"))
+        settings.block_size = std::max(AUTOMATION_INTERVAL, arguments.getValueForOption("--block").getIntValue());
+    settings.tail = arguments.containsOption("--tail");
+
+    // Check the parameter IDs once up front rather than in every job
+    {
+        FilterPluginAudioProcessor probe;
+        for (auto& key : settings.parameters.getAllKeys())
+        {
+            if (probe.getParameterState()->getParameter(key) == nullptr)
+            {
+                std::cerr << "Unknown parameter " << key << std::endl;
+                return 1;
+            }
+        }
+        for (auto& lane : settings.automation)
+        {
+            if (probe.getParameterState()->getParameter(lane.parameter_id) == nullptr)
+            {
+                std::cerr << "Unknown parameter " << lane.parameter_id << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Linear phase designs its kernels on a background thread, so the start
+    // of an offline render wouldn't be deterministic
+    if (settings.parameters["phase"].getIntValue() != 0)
+    {
+        std::cerr << "Linear phase isn't supported offline, rendering minimum phase" << std::endl;
+        settings.parameters.set("phase", "0");
+    }
+
+    auto num_jobs = arguments.containsOption("--jobs")
+                  ? arguments.getValueForOption("--jobs").getIntValue()
+                  : juce::SystemStats::getNumCpus();
+    num_jobs = juce::jlimit(1, std::max(1, inputs.size()), num_jobs);
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    ProcessorPool processors(num_jobs);
+    std::atomic<int> failures { 0 };
+    juce::CriticalSection output_lock;
+    {
+        juce::ThreadPool pool(num_jobs);
+        for (auto& input : inputs)
+            pool.addJob(new RenderJob(input, settings, formats, processors, failures, output_lock), true);
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep(50);
+    }
+
+    return failures.load() == 0 ? 0 : 1;
+}
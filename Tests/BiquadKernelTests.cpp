@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+#include "../FilterPlugin/FilterBank.h"
+
+//==============================================================================
+// FilterBank picks a specialised kernel per section (bypass, first order,
+// biquad, SVF; static or ramping; SIMD or scalar). Runs a sequence of jumps
+// and ramps between sections of every shape through the bank and through a
+// plain per-channel reference that always runs the full kernel, in both
+// topologies and sample types, and compares.
+class BiquadKernelTests : public juce::UnitTest
+{
+public:
+    BiquadKernelTests() : juce::UnitTest("BiquadKernels", "FilterPlugin") {}
+
+    void runTest() override
+    {
+        for (auto topology : { FilterTopology::transposed_direct_form_2, FilterTopology::state_variable })
+        {
+            const juce::String name = topology == FilterTopology::state_variable ? "state variable" : "direct form";
+
+            beginTest("Kernels match the reference, " + name + ", double");
+            check<double>(topology, MAX_DOUBLE_ERROR);
+
+            beginTest("Kernels match the reference, " + name + ", float");
+            check<float>(topology, MAX_FLOAT_ERROR);
+        }
+    }
+
+private:
+    static constexpr int NUM_CHANNELS = 5; // a SIMD group and a scalar rest on every target
+    static constexpr int NUM_SECTIONS = 3;
+    static constexpr int NUM_SAMPLES = 48000;
+    static constexpr double SAMPLE_RATE = 48000.0;
+    static constexpr double MAX_DOUBLE_ERROR = 3e-13;
+    static constexpr double MAX_FLOAT_ERROR = 1e-6;
+
+    static constexpr double PI = 3.141592653589793238463;
+
+    //==========================================================================
+    // Cookbook designs covering every SectionKernel: a peak at 0 dB is an
+    // identity, a bilinear one-pole low pass is first order.
+    static BiquadCoefficients peak(double fc, double Q, double gain)
+    {
+        const double A = std::pow(10.0, gain / 40.0), w = 2.0 * PI * fc / SAMPLE_RATE, alpha = std::sin(w) / (2.0 * Q);
+        const double a0 = 1.0 + alpha / A;
+        return { (1.0 + alpha * A) / a0, -2.0 * std::cos(w) / a0, (1.0 - alpha * A) / a0, -2.0 * std::cos(w) / a0, (1.0 - alpha / A) / a0 };
+    }
+
+    static BiquadCoefficients lowPass(double fc, double Q)
+    {
+        const double w = 2.0 * PI * fc / SAMPLE_RATE, alpha = std::sin(w) / (2.0 * Q), cw = std::cos(w);
+        const double a0 = 1.0 + alpha;
+        return { (1.0 - cw) / 2.0 / a0, (1.0 - cw) / a0, (1.0 - cw) / 2.0 / a0, -2.0 * cw / a0, (1.0 - alpha) / a0 };
+    }
+
+    static BiquadCoefficients onePole(double fc)
+    {
+        const double K = std::tan(PI * fc / SAMPLE_RATE);
+        return { K / (1.0 + K), K / (1.0 + K), 0.0, (K - 1.0) / (1.0 + K), 0.0 };
+    }
+
+    //==========================================================================
+    // Every section of every channel runs the full kernel of its topology,
+    // with the rules of FilterBank: all sections share one ramp, each
+    // coefficient moves by its delta before every sample, lands exactly on
+    // its target, and a jump cuts a running ramp short. An identity section
+    // is only skipped, and its state cleared, once that state is below
+    // BYPASS_STATE_THRESHOLD on every channel.
+    class Reference
+    {
+    public:
+        explicit Reference(FilterTopology topology) : _topology(topology)
+        {
+            for (auto& section : _sections)
+            {
+                section.current = section.target = pack(BiquadCoefficients());
+            }
+        }
+
+        void set(int section, const BiquadCoefficients& c)
+        {
+            if (_ramp_remaining > 0)
+                land();
+            auto& s = _sections[static_cast<size_t>(section)];
+            s.current = s.target = pack(c);
+            s.identity = s.target_identity = classifySection(c, _topology) == SectionKernel::bypass;
+        }
+
+        void ramp(int section, const BiquadCoefficients& c, int numSamples)
+        {
+            auto& s = _sections[static_cast<size_t>(section)];
+            s.target = pack(c);
+            s.target_identity = classifySection(c, _topology) == SectionKernel::bypass;
+            const double scale = 1.0 / numSamples;
+            for (size_t i = 0; i < 5; ++i)
+            {
+                s.delta[i] = (s.target[i] - s.current[i]) * scale;
+            }
+            _ramp_remaining = numSamples;
+        }
+
+        template <typename SampleType>
+        void process(SampleType* const* channels, int startSample, int numSamples)
+        {
+            if (_ramp_remaining > 0)
+            {
+                const int ramp_samples = std::min(numSamples, _ramp_remaining);
+                run(channels, startSample, ramp_samples, true);
+                startSample += ramp_samples;
+                numSamples -= ramp_samples;
+                _ramp_remaining -= ramp_samples;
+                if (_ramp_remaining == 0)
+                    land();
+            }
+            run(channels, startSample, numSamples, false);
+        }
+
+    private:
+        using Packed = std::array<double, 5>;
+
+        struct Section
+        {
+            Packed current {}, target {}, delta {};
+            bool identity = true, target_identity = true;
+            std::array<double, NUM_CHANNELS> z1 {}, z2 {};
+        };
+
+        Packed pack(const BiquadCoefficients& c) const
+        {
+            if (_topology == FilterTopology::state_variable)
+            {
+                const auto svf = toSvf(c);
+                return { svf.g, svf.k, svf.m0, svf.m1, svf.m2 };
+            }
+            return { c.b0, c.b1, c.b2, c.a1, c.a2 };
+        }
+
+        void land()
+        {
+            for (auto& section : _sections)
+            {
+                section.current = section.target;
+                section.delta = {};
+                section.identity = section.target_identity;
+            }
+            _ramp_remaining = 0;
+        }
+
+        template <typename SampleType>
+        void run(SampleType* const* channels, int startSample, int numSamples, bool ramp)
+        {
+            for (auto& section : _sections)
+            {
+                if (section.identity && (!ramp || section.target_identity) && settled(section))
+                {
+                    section.z1 = {};
+                    section.z2 = {};
+                    continue;
+                }
+
+                Packed start = section.current;
+                for (int channel = 0; channel < NUM_CHANNELS; ++channel)
+                {
+                    auto c = start;
+                    auto& s1 = section.z1[static_cast<size_t>(channel)];
+                    auto& s2 = section.z2[static_cast<size_t>(channel)];
+                    for (int i = startSample; i < startSample + numSamples; ++i)
+                    {
+                        if (ramp)
+                        {
+                            for (size_t j = 0; j < 5; ++j)
+                            {
+                                c[j] = c[j] + section.delta[j];
+                            }
+                        }
+
+                        const double x = channels[channel][i];
+                        double y;
+                        if (_topology == FilterTopology::state_variable)
+                        {
+                            const double h1 = 1.0 / (1.0 + c[0] * (c[0] + c[1]));
+                            const double h2 = c[0] * h1;
+                            const double h3 = c[0] * h2;
+                            const double v3 = x - s2;
+                            const double band = h1 * s1 + h2 * v3;
+                            const double low = s2 + h2 * s1 + h3 * v3;
+                            s1 = 2.0 * band - s1;
+                            s2 = 2.0 * low - s2;
+                            y = c[2] * x + c[3] * band + c[4] * low;
+                        }
+                        else
+                        {
+                            y = c[0] * x + s1;
+                            s1 = c[1] * x - c[3] * y + s2;
+                            s2 = c[2] * x - c[4] * y;
+                        }
+                        channels[channel][i] = static_cast<SampleType>(y);
+                    }
+                    section.current = c;
+                }
+            }
+        }
+
+        static bool settled(const Section& section)
+        {
+            const auto below = [](double z) { return std::abs(z) <= BYPASS_STATE_THRESHOLD; };
+            return std::all_of(section.z1.begin(), section.z1.end(), below) && std::all_of(section.z2.begin(), section.z2.end(), below);
+        }
+
+        FilterTopology _topology;
+        std::array<Section, NUM_SECTIONS> _sections;
+        int _ramp_remaining = 0;
+    };
+
+    //==========================================================================
+    template <typename SampleType>
+    void check(FilterTopology topology, double maxError)
+    {
+        std::vector<std::vector<SampleType>> bank_data(NUM_CHANNELS), reference_data(NUM_CHANNELS);
+        std::vector<SampleType*> bank_channels, reference_channels;
+        juce::Random random(3);
+        for (int channel = 0; channel < NUM_CHANNELS; ++channel)
+        {
+            auto& data = bank_data[static_cast<size_t>(channel)];
+            data.resize(NUM_SAMPLES);
+            for (int i = 0; i < NUM_SAMPLES; ++i)
+            {
+                data[static_cast<size_t>(i)] = static_cast<SampleType>(0.5 * std::sin(0.01 * i * (channel + 1)) + random.nextDouble() - 0.5);
+            }
+            reference_data[static_cast<size_t>(channel)] = data;
+            bank_channels.push_back(data.data());
+            reference_channels.push_back(reference_data[static_cast<size_t>(channel)].data());
+        }
+
+        FilterBank bank;
+        bank.prepare(NUM_CHANNELS, NUM_SECTIONS);
+        bank.setTopology(topology);
+        bank.setNumSections(NUM_SECTIONS);
+        Reference reference(topology);
+
+        auto set = [&](int section, const BiquadCoefficients& c) { bank.setCoefficients(section, c); reference.set(section, c); };
+        auto ramp = [&](int section, const BiquadCoefficients& c, int length) { bank.rampCoefficients(section, c, length); reference.ramp(section, c, length); };
+        int position = 0;
+        auto advance = [&](int numSamples)
+        {
+            // Uneven block sizes, so ramps end part way through blocks
+            for (int end = std::min(position + numSamples, NUM_SAMPLES); position < end;)
+            {
+                const int length = std::min(end - position, 1 + random.nextInt(100));
+                bank.process(bank_channels.data(), NUM_CHANNELS, position, length);
+                reference.process(reference_channels.data(), position, length);
+                position += length;
+            }
+        };
+
+        set(0, peak(1000.0, 2.0, 6.0));
+        set(1, onePole(5000.0));
+        set(2, peak(300.0, 1.0, 0.0));
+        advance(8000);
+
+        // First order to biquad, biquad to identity
+        ramp(0, peak(2000.0, 4.0, 0.0), 256);
+        ramp(1, lowPass(3000.0, 0.7), 256);
+        ramp(2, peak(300.0, 1.0, 0.0), 256);
+        advance(8000);
+
+        // Biquad to first order, identity to biquad, cut short by a jump
+        ramp(0, peak(2000.0, 4.0, 0.0), 512);
+        ramp(1, onePole(3000.0), 512);
+        ramp(2, peak(300.0, 1.0, 3.0), 512);
+        advance(300);
+        set(0, peak(500.0, 1.0, -3.0));
+        advance(8000);
+
+        // Jumps onto an identity while the state still rings, so it has to
+        // keep running until it has decayed
+        set(1, onePole(800.0));
+        set(2, peak(300.0, 1.0, 0.0));
+        advance(8000);
+
+        ramp(1, onePole(2000.0), 100);
+        ramp(2, lowPass(9000.0, 2.0), 100);
+        advance(NUM_SAMPLES);
+
+        double error = 0.0, peak_level = 0.0;
+        for (int channel = 0; channel < NUM_CHANNELS; ++channel)
+        {
+            for (int i = 0; i < NUM_SAMPLES; ++i)
+            {
+                const double expected = reference_channels[static_cast<size_t>(channel)][i];
+                error = std::max(error, std::abs(static_cast<double>(bank_channels[static_cast<size_t>(channel)][i]) - expected));
+                peak_level = std::max(peak_level, std::abs(expected));
+            }
+        }
+
+        const double relative = error / peak_level;
+        logMessage("largest difference " + juce::String(relative) + " of the peak level");
+        expectLessOrEqual(relative, maxError);
+    }
+};
+
+static BiquadKernelTests biquad_kernel_tests;
@@ -0,0 +1,234 @@
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+#include "../FilterPlugin/FilterBank.h"
+
+//==============================================================================
+// Hammers the worker pool with back-to-back jobs of random sizes, with pauses
+// long enough for the workers to park in between, and checks every task runs
+// exactly once per job, also with workers held up while they read a job so
+// the next one starts under them. Then runs a wide FilterBank with and
+// without workers and expects bit-identical output.
+class ChannelWorkersTests : public juce::UnitTest
+{
+public:
+    ChannelWorkersTests() : juce::UnitTest("ChannelWorkers", "FilterPlugin") {}
+
+    void runTest() override
+    {
+        beginTest("Every task of every job runs exactly once");
+        for (int num_workers : { 1, 3, MAX_CHANNEL_WORKERS })
+        {
+            checkJobs(num_workers);
+        }
+
+        beginTest("Late workers never run a task of the next job");
+        for (int num_workers : { 1, 3, MAX_CHANNEL_WORKERS })
+        {
+            checkLateWorkers(num_workers);
+        }
+
+        beginTest("A bank spread over workers matches the serial one");
+        for (int num_workers : { 1, MAX_CHANNEL_WORKERS })
+        {
+            checkFilterBank<float>(num_workers);
+            checkFilterBank<double>(num_workers);
+        }
+    }
+
+private:
+    static constexpr int NUM_JOBS = 20000;
+    static constexpr int NUM_LATE_JOBS = 1000;
+    static constexpr int MAX_TASKS = 40;
+    static constexpr int NUM_CHANNELS = 35; // a scalar rest after the SIMD groups
+    static constexpr int NUM_SECTIONS = 4;
+    static constexpr int NUM_BLOCKS = 400;
+    static constexpr int MAX_BLOCK_SIZE = 1024;
+    static constexpr double SAMPLE_RATE = 48000.0;
+
+    struct Job
+    {
+        std::vector<std::atomic<int>> runs = std::vector<std::atomic<int>>(MAX_TASKS);
+        int work = 0;
+
+        static void run(void* context, int task)
+        {
+            auto& job = *static_cast<Job*>(context);
+
+            // Uneven task lengths, so tasks finish out of order
+            volatile double sink = 0.0;
+            for (int i = 0; i < (task % 5) * job.work; ++i)
+                sink = sink + std::sqrt(static_cast<double>(i));
+
+            job.runs[static_cast<size_t>(task)].fetch_add(1);
+        }
+    };
+
+    void checkJobs(int numWorkers)
+    {
+        ChannelWorkers workers;
+        workers.prepare(numWorkers);
+        expectEquals(workers.getNumThreads(), numWorkers + 1);
+
+        juce::Random random(numWorkers);
+        Job job;
+        int failures = 0;
+        for (int i = 0; i < NUM_JOBS; ++i)
+        {
+            const int num_tasks = random.nextInt(MAX_TASKS + 1);
+            job.work = random.nextInt(200);
+            for (auto& runs : job.runs)
+                runs.store(0);
+
+            workers.run(num_tasks, &Job::run, &job);
+
+            for (int task = 0; task < MAX_TASKS; ++task)
+            {
+                if (job.runs[static_cast<size_t>(task)].load() != (task < num_tasks ? 1 : 0))
+                    ++failures;
+            }
+
+            // Now and then let the workers park, so the next job wakes them
+            if (random.nextInt(500) == 0)
+                juce::Thread::sleep(2);
+        }
+        expectEquals(failures, 0, juce::String(numWorkers) + " workers");
+
+        // Preparing again replaces the threads
+        workers.prepare(numWorkers);
+        job.work = 0;
+        for (auto& runs : job.runs)
+            runs.store(0);
+        workers.run(MAX_TASKS, &Job::run, &job);
+        for (int task = 0; task < MAX_TASKS; ++task)
+            expectEquals(job.runs[static_cast<size_t>(task)].load(), 1);
+        workers.release();
+    }
+
+    // Holds workers up before they read a job, long enough now and then for
+    // the caller to finish it alone, and the caller up while it replaces the
+    // job, so a late worker reads it half written.
+    static void holdUp()
+    {
+        thread_local unsigned int calls = 0;
+        if (++calls % 16 == 0)
+            juce::Thread::sleep(1);
+        else
+            juce::Thread::yield();
+    }
+
+    void checkLateWorkers(int numWorkers)
+    {
+        ChannelWorkers workers;
+        workers.setJobReadHook(&holdUp);
+        workers.prepare(numWorkers);
+
+        // Alternating contexts, so a task run with the wrong job's fields
+        // shows up in the job that isn't running
+        juce::Random random(numWorkers);
+        std::array<Job, 2> jobs;
+        int failures = 0;
+        for (int i = 0; i < NUM_LATE_JOBS; ++i)
+        {
+            auto& job = jobs[static_cast<size_t>(i % 2)];
+            const auto& other = jobs[static_cast<size_t>((i + 1) % 2)];
+            const int num_tasks = 2 + random.nextInt(MAX_TASKS - 1);
+            job.work = random.nextInt(20);
+
+            workers.run(num_tasks, &Job::run, &job);
+
+            for (int task = 0; task < MAX_TASKS; ++task)
+            {
+                if (job.runs[static_cast<size_t>(task)].load() != (task < num_tasks ? 1 : 0))
+                    ++failures;
+                if (other.runs[static_cast<size_t>(task)].load() != 0)
+                    ++failures;
+            }
+            for (auto& runs : job.runs)
+                runs.store(0);
+        }
+        expectEquals(failures, 0, juce::String(numWorkers) + " workers");
+        workers.release();
+    }
+
+    static BiquadCoefficients peak(double fc, double Q, double gain)
+    {
+        constexpr double two_pi = 6.283185307179586476925;
+        const double A = std::pow(10.0, gain / 40.0), w = two_pi * fc / SAMPLE_RATE, alpha = std::sin(w) / (2.0 * Q);
+        const double a0 = 1.0 + alpha / A;
+        return { (1.0 + alpha * A) / a0, -2.0 * std::cos(w) / a0, (1.0 - alpha * A) / a0, -2.0 * std::cos(w) / a0, (1.0 - alpha / A) / a0 };
+    }
+
+    template <typename SampleType>
+    void checkFilterBank(int numWorkers)
+    {
+        ChannelWorkers workers;
+        workers.prepare(numWorkers);
+
+        std::vector<std::vector<SampleType>> serial_data(NUM_CHANNELS, std::vector<SampleType>(MAX_BLOCK_SIZE));
+        std::vector<std::vector<SampleType>> parallel_data(NUM_CHANNELS, std::vector<SampleType>(MAX_BLOCK_SIZE));
+        std::vector<SampleType*> serial_channels, parallel_channels;
+        for (int channel = 0; channel < NUM_CHANNELS; ++channel)
+        {
+            serial_channels.push_back(serial_data[static_cast<size_t>(channel)].data());
+            parallel_channels.push_back(parallel_data[static_cast<size_t>(channel)].data());
+        }
+
+        FilterBank serial, parallel;
+        for (auto* bank : { &serial, &parallel })
+        {
+            bank->prepare(NUM_CHANNELS, NUM_SECTIONS);
+            bank->setNumSections(NUM_SECTIONS);
+        }
+
+        juce::Random random(7);
+        int mismatches = 0;
+        for (int block = 0; block < NUM_BLOCKS; ++block)
+        {
+            // Some blocks are too small to be worth spreading out
+            const int num_samples = 1 + random.nextInt(MAX_BLOCK_SIZE);
+            for (int channel = 0; channel < NUM_CHANNELS; ++channel)
+            {
+                for (int i = 0; i < num_samples; ++i)
+                {
+                    const auto x = static_cast<SampleType>(random.nextDouble() - 0.5);
+                    serial_data[static_cast<size_t>(channel)][static_cast<size_t>(i)] = x;
+                    parallel_data[static_cast<size_t>(channel)][static_cast<size_t>(i)] = x;
+                }
+            }
+
+            if (block % 3 == 0)
+            {
+                // All sections share one ramp length
+                const int ramp_length = 1 + random.nextInt(2 * MAX_BLOCK_SIZE);
+                for (int section = 0; section < NUM_SECTIONS; ++section)
+                {
+                    const auto c = peak(100.0 + 4000.0 * random.nextDouble(), 0.5 + 4.0 * random.nextDouble(),
+                                        random.nextInt(4) == 0 ? 0.0 : 24.0 * random.nextDouble() - 12.0);
+                    serial.rampCoefficients(section, c, ramp_length);
+                    parallel.rampCoefficients(section, c, ramp_length);
+                }
+            }
+
+            serial.process(serial_channels.data(), NUM_CHANNELS, 0, num_samples);
+            parallel.process(parallel_channels.data(), NUM_CHANNELS, 0, num_samples, &workers);
+
+            for (int channel = 0; channel < NUM_CHANNELS; ++channel)
+            {
+                for (int i = 0; i < num_samples; ++i)
+                {
+                    if (serial_data[static_cast<size_t>(channel)][static_cast<size_t>(i)]
+                        != parallel_data[static_cast<size_t>(channel)][static_cast<size_t>(i)])
+                        ++mismatches;
+                }
+            }
+        }
+        expectEquals(mismatches, 0, juce::String(numWorkers) + " workers");
+    }
+};
+
+static ChannelWorkersTests channel_workers_tests;
@@ -0,0 +1,128 @@
+#include <cmath>
+
+#include <juce_core/juce_core.h>
+
+#include "../FilterPlugin/CoefficientTable.h"
+#include "../FilterPlugin/FrequencyResponse.h"
+
+//==============================================================================
+// CoefficientTable interpolates designs between grid points. Checks random
+// off-grid settings for stability over the whole table, and for magnitude
+// error against the exact design over 20 Hz - 20 kHz, Q 0.1 - 10 and
+// +-24 dB.
+class CoefficientTableTests : public juce::UnitTest
+{
+public:
+    CoefficientTableTests() : juce::UnitTest("CoefficientTable", "FilterPlugin") {}
+
+    void runTest() override
+    {
+        const double sample_rates[] = { 44100.0, 96000.0, 192000.0 };
+
+        for (auto sample_rate : sample_rates)
+        {
+            CoefficientTable table;
+            table.build(sample_rate);
+            FilterDesigner designer;
+            designer.reset(sample_rate);
+            juce::Random random(2);
+
+            beginTest("Lookups are stable at " + juce::String(sample_rate) + " Hz");
+
+            double largest_radius = 0.0;
+            for (int algorithm = 0; algorithm < rubdsp::filterAlgorithm::NUM_ALGROITHMS; ++algorithm)
+            {
+                for (int i = 0; i < NUM_CASES; ++i)
+                {
+                    const double fc = TABLE_FREQUENCY_MIN * std::pow(0.5 * sample_rate / TABLE_FREQUENCY_MIN, random.nextDouble());
+                    const double Q = TABLE_Q_MAX * random.nextDouble();
+                    const double gain = TABLE_GAIN_MIN + (TABLE_GAIN_MAX - TABLE_GAIN_MIN) * random.nextDouble();
+                    largest_radius = std::max(largest_radius, poleRadius(table.lookup(algorithm, fc, Q, gain)));
+                }
+            }
+            logMessage("largest pole radius " + juce::String(largest_radius, 9));
+            expectLessThan(largest_radius, 1.0);
+
+            beginTest("Lookups match the exact designs at " + juce::String(sample_rate) + " Hz");
+
+            for (int algorithm = 0; algorithm < rubdsp::filterAlgorithm::NUM_ALGROITHMS; ++algorithm)
+            {
+                double worst = 0.0;
+                juce::String worst_case;
+                int num_cases = 0;
+                for (int i = 0; i < NUM_CASES; ++i)
+                {
+                    auto parameters = designer.getParameters();
+                    parameters.algorithm = static_cast<rubdsp::filterAlgorithm>(algorithm);
+                    parameters.fc = 20.0 * std::pow(std::min(1000.0, 0.45 * sample_rate / 20.0), random.nextDouble());
+                    parameters.Q = 0.1 * std::pow(100.0, random.nextDouble());
+                    parameters.boost_cut_db = -24.0 + 48.0 * random.nextDouble();
+
+                    if (!isContinuous(designer, parameters))
+                        continue;
+
+                    const auto exact = designer.design(parameters);
+                    const auto interpolated = table.lookup(algorithm, parameters.fc, parameters.Q, parameters.boost_cut_db);
+                    const auto error = magnitudeError(exact, interpolated, sample_rate);
+                    ++num_cases;
+                    if (!(error <= worst))
+                    {
+                        worst = error;
+                        worst_case = juce::String(parameters.fc) + " Hz, Q " + juce::String(parameters.Q)
+                                   + ", " + juce::String(parameters.boost_cut_db) + " dB";
+                    }
+                }
+
+                const juce::String name(rubdsp::filterAlgorithmStrings[algorithm]);
+                logMessage(name + ": " + juce::String(num_cases) + " settings, worst error "
+                           + juce::String(worst, 3) + " dB (" + worst_case + ")");
+                expect(num_cases > 0, "no settings were tried for " + name);
+                expect(worst <= MAX_ERROR_DB, name + " off by " + juce::String(worst) + " dB at " + worst_case);
+            }
+        }
+    }
+
+private:
+    static constexpr int NUM_CASES = 2000;
+    static constexpr int NUM_FREQUENCIES = 96;
+    static constexpr double MAX_ERROR_DB = 1.0;
+
+    // Responses are compared above this level, deep stop bands and notches
+    // don't need to match
+    static constexpr double FLOOR = 1e-3;
+
+    // Some algorithms blow up or jump past a pole of their prewarping for
+    // extreme Q against fc. No grid follows that, so only compare settings
+    // where the design is stable a grid step of Q either side.
+    static bool isContinuous(FilterDesigner& designer, FilterParameters parameters)
+    {
+        const double Q = parameters.Q;
+        const double Q_step = std::pow(TABLE_Q_MAX / TABLE_Q_MIN, 1.0 / (TABLE_Q_POINTS - 1));
+        for (auto factor : { 1.0, Q_step, 1.0 / Q_step })
+        {
+            parameters.Q = Q * factor;
+            if (!(poleRadius(designer.design(parameters)) < 1.0))
+                return false;
+        }
+        return true;
+    }
+
+    static double magnitudeError(const BiquadCoefficients& exact, const BiquadCoefficients& interpolated, double sampleRate)
+    {
+        double error = 0.0;
+        for (int k = 0; k < NUM_FREQUENCIES; ++k)
+        {
+            const double frequency = 10.0 * std::pow(2000.0, k / (NUM_FREQUENCIES - 1.0));
+            if (frequency >= 0.5 * sampleRate)
+                break;
+
+            const auto terms = ResponseTerms::at(frequency, sampleRate);
+            const double a = std::pow(10.0, magnitudedB(exact, terms) / 20.0);
+            const double b = std::pow(10.0, magnitudedB(interpolated, terms) / 20.0);
+            error = std::max(error, std::abs(20.0 * std::log10((b + FLOOR) / (a + FLOOR))));
+        }
+        return error;
+    }
+};
+
+static CoefficientTableTests coefficient_table_tests;
@@ -0,0 +1,151 @@
+#include <cmath>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+#include "../FilterPlugin/FilterDesigner.h"
+
+//==============================================================================
+// FilterDesigner recovers direct form coefficients from rubdsp's impulse
+// response. Replays white noise through both and compares, over every
+// algorithm, 20 Hz - 20 kHz, Q 0.1 - 10, a few gains and 44.1 - 384 kHz.
+// Then checks the algorithms it finds not to use Q or gain really don't.
+class FilterDesignerTests : public juce::UnitTest
+{
+public:
+    FilterDesignerTests() : juce::UnitTest("FilterDesigner", "FilterPlugin") {}
+
+    void runTest() override
+    {
+        const double sample_rates[] = { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0, 352800.0, 384000.0 };
+        const double gains[] = { -24.0, 0.0, 12.0 };
+        constexpr int num_frequencies = 16;
+        constexpr int num_Qs = 7;
+
+        std::vector<double> noise(NUM_SAMPLES);
+        juce::Random random(1);
+        for (auto& sample : noise)
+            sample = 2.0 * random.nextDouble() - 1.0;
+
+        beginTest("Fitted sections match rubdsp");
+
+        double worst = 0.0;
+        juce::String worst_case;
+        int num_cases = 0;
+        for (int algorithm = 0; algorithm < rubdsp::filterAlgorithm::NUM_ALGROITHMS; ++algorithm)
+        {
+            for (auto sample_rate : sample_rates)
+            {
+                for (int f = 0; f < num_frequencies; ++f)
+                {
+                    for (int q = 0; q < num_Qs; ++q)
+                    {
+                        for (auto gain : gains)
+                        {
+                            FilterDesigner designer;
+                            designer.reset(sample_rate);
+                            auto parameters = designer.getParameters();
+                            parameters.algorithm = static_cast<rubdsp::filterAlgorithm>(algorithm);
+                            parameters.fc = 20.0 * std::pow(1000.0, f / (num_frequencies - 1.0));
+                            parameters.Q = 0.1 * std::pow(100.0, q / (num_Qs - 1.0));
+                            parameters.boost_cut_db = gain;
+
+                            // A design rubdsp can't run stably itself is nothing to match
+                            if (!isStable(parameters, sample_rate))
+                                continue;
+
+                            const auto error = replayError(designer.design(parameters), parameters, sample_rate, noise);
+                            ++num_cases;
+                            if (!(error <= worst))
+                            {
+                                worst = error;
+                                worst_case = juce::String(rubdsp::filterAlgorithmStrings[algorithm]) + " at "
+                                           + juce::String(parameters.fc) + " Hz, Q " + juce::String(parameters.Q)
+                                           + ", " + juce::String(gain) + " dB, " + juce::String(sample_rate) + " Hz";
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        logMessage(juce::String(num_cases) + " designs, worst relative error " + juce::String(worst)
+                   + " (" + worst_case + ")");
+        expect(num_cases > 0, "no stable designs were tried");
+        expect(worst <= MAX_RELATIVE_ERROR, "worst relative error " + juce::String(worst) + " for " + worst_case);
+
+        beginTest("Algorithms ignore the parameters they are probed not to use");
+        for (auto sample_rate : sample_rates)
+        {
+            FilterDesigner designer;
+            designer.reset(sample_rate);
+            for (int algorithm = 0; algorithm < rubdsp::filterAlgorithm::NUM_ALGROITHMS; ++algorithm)
+            {
+                const juce::String name = rubdsp::filterAlgorithmStrings[algorithm];
+                for (int f = 0; f < num_frequencies; ++f)
+                {
+                    const double fc = 20.0 * std::pow(1000.0, f / (num_frequencies - 1.0));
+                    auto design = [&](double Q, double boost_cut)
+                    {
+                        auto parameters = designer.getParameters();
+                        parameters.algorithm = static_cast<rubdsp::filterAlgorithm>(algorithm);
+                        parameters.fc = fc;
+                        parameters.Q = Q;
+                        parameters.boost_cut_db = boost_cut;
+                        return designer.design(parameters);
+                    };
+                    if (!designer.usesQ(algorithm))
+                        expect(!differs(design(0.1, 6.0), design(10.0, 6.0)), name + " depends on Q at " + juce::String(fc) + " Hz");
+                    if (!designer.usesGain(algorithm))
+                        expect(!differs(design(1.0, -24.0), design(1.0, 12.0)), name + " depends on gain at " + juce::String(fc) + " Hz");
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr int NUM_SAMPLES = 4096;
+    static constexpr double MAX_RELATIVE_ERROR = 1e-6;
+    static constexpr double MAX_IGNORED_DIFFERENCE = 1e-9;
+
+    static bool differs(const BiquadCoefficients& a, const BiquadCoefficients& b)
+    {
+        return std::abs(a.b0 - b.b0) > MAX_IGNORED_DIFFERENCE || std::abs(a.b1 - b.b1) > MAX_IGNORED_DIFFERENCE
+            || std::abs(a.b2 - b.b2) > MAX_IGNORED_DIFFERENCE || std::abs(a.a1 - b.a1) > MAX_IGNORED_DIFFERENCE
+            || std::abs(a.a2 - b.a2) > MAX_IGNORED_DIFFERENCE;
+    }
+
+    static bool isStable(const FilterParameters& parameters, double sampleRate)
+    {
+        rubdsp::AudioFilter filter;
+        filter.reset(sampleRate);
+        filter.setParameters(parameters);
+        double last = filter.processAudioSample(1.0);
+        for (int n = 1; n < NUM_SAMPLES; ++n)
+            last = filter.processAudioSample(0.0);
+        return std::isfinite(last) && std::abs(last) < 1.0;
+    }
+
+    // Largest output difference relative to rubdsp's peak output.
+    static double replayError(const BiquadCoefficients& c, const FilterParameters& parameters, double sampleRate,
+                              const std::vector<double>& input)
+    {
+        rubdsp::AudioFilter filter;
+        filter.reset(sampleRate);
+        filter.setParameters(parameters);
+
+        double z1 = 0.0, z2 = 0.0, error = 0.0, peak = 0.0;
+        for (auto x : input)
+        {
+            const double expected = filter.processAudioSample(x);
+            const double y = c.b0 * x + z1;
+            z1 = c.b1 * x - c.a1 * y + z2;
+            z2 = c.b2 * x - c.a2 * y;
+            error = std::max(error, std::abs(y - expected));
+            peak = std::max(peak, std::abs(expected));
+        }
+        return peak > 0.0 ? error / peak : error;
+    }
+};
+
+static FilterDesignerTests filter_designer_tests;
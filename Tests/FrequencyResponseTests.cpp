@@ -0,0 +1,158 @@
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+#include "../FilterPlugin/FrequencyResponse.h"
+
+//==============================================================================
+// evaluateResponse against the textbook evaluation of the cascade with
+// std::complex: the magnitude and phase of the product of N(z) / D(z), and the
+// group delay as the numerical derivative of that phase.
+class FrequencyResponseTests : public juce::UnitTest
+{
+public:
+    FrequencyResponseTests() : juce::UnitTest("FrequencyResponse", "FilterPlugin") {}
+
+    void runTest() override
+    {
+        juce::Random random(25);
+
+        beginTest("Random cascades match std::complex");
+        for (int i = 0; i < NUM_CASCADES; ++i)
+        {
+            Snapshot snapshot;
+            snapshot.sample_rate = i % 2 == 0 ? 48000.0 : 192000.0;
+            snapshot.num_sections = 1 + random.nextInt(MAX_SECTIONS);
+            for (int section = 0; section < snapshot.num_sections; ++section)
+            {
+                snapshot.sections[static_cast<size_t>(section)] = randomSection(random);
+            }
+            check(snapshot);
+        }
+        logMessage("largest errors: " + juce::String(_magnitude_error) + " dB, " + juce::String(_phase_error)
+                   + " degrees, " + juce::String(_delay_error) + " of the group delay");
+
+        beginTest("First-order and identity sections");
+        {
+            Snapshot snapshot;
+            snapshot.sample_rate = 44100.0;
+            snapshot.num_sections = 3;
+            snapshot.sections[0] = { 0.2, 0.2, 0.0, -0.6, 0.0 };
+            snapshot.sections[1] = { 1.0, -1.2, 0.5, -1.2, 0.5 };
+            snapshot.sections[2] = { 0.9, -0.5, 0.0, 0.0, 0.0 };
+            check(snapshot);
+        }
+
+        beginTest("Curves left null are skipped");
+        {
+            Snapshot snapshot;
+            snapshot.sample_rate = 48000.0;
+            snapshot.num_sections = 2;
+            snapshot.sections[0] = randomSection(random);
+            snapshot.sections[1] = randomSection(random);
+            const auto terms = makeTerms(snapshot.sample_rate);
+
+            std::vector<float> magnitude(NUM_POINTS), phase(NUM_POINTS), delay(NUM_POINTS), only(NUM_POINTS);
+            evaluateResponse(snapshot, terms.data(), terms.size(), { magnitude.data(), phase.data(), delay.data() });
+            evaluateResponse(snapshot, terms.data(), terms.size(), { nullptr, only.data(), nullptr });
+            expect(phase == only);
+        }
+    }
+
+private:
+    static constexpr int MAX_SECTIONS = 8;
+    static constexpr int NUM_CASCADES = 200;
+    static constexpr size_t NUM_POINTS = 203; // not a whole number of batches
+    static constexpr double MAX_MAGNITUDE_ERROR_DB = 1e-4;
+    static constexpr double MAX_PHASE_ERROR_DEGREES = 1e-3;
+    static constexpr double MAX_DELAY_ERROR = 1e-5; // relative, with a floor of one microsecond
+
+    static constexpr double PI = 3.141592653589793238463;
+
+    using Snapshot = BasicResponseSnapshot<MAX_SECTIONS>;
+
+    // Stable poles and zeros kept away from the unit circle, where the group
+    // delay has a pole of its own.
+    static BiquadCoefficients randomSection(juce::Random& random)
+    {
+        const double pole_radius = 0.98 * random.nextDouble();
+        const double pole_angle = PI * random.nextDouble();
+        const double zero_radius = random.nextBool() ? 0.9 * random.nextDouble() : 1.1 + random.nextDouble();
+        const double zero_angle = PI * random.nextDouble();
+        const double gain = 0.1 + 2.0 * random.nextDouble();
+        return { gain, -2.0 * gain * zero_radius * std::cos(zero_angle), gain * zero_radius * zero_radius,
+                 -2.0 * pole_radius * std::cos(pole_angle), pole_radius * pole_radius };
+    }
+
+    static std::vector<ResponseTerms> makeTerms(double sampleRate)
+    {
+        std::vector<ResponseTerms> terms;
+        for (size_t i = 0; i < NUM_POINTS; ++i)
+        {
+            terms.push_back(ResponseTerms::at(frequencyAt(i, sampleRate), sampleRate));
+        }
+        return terms;
+    }
+
+    // 10 Hz to just below Nyquist, log spaced
+    static double frequencyAt(size_t index, double sampleRate)
+    {
+        return 10.0 * std::pow(0.499 * sampleRate / 10.0, static_cast<double>(index) / (NUM_POINTS - 1));
+    }
+
+    static std::complex<double> reference(const Snapshot& snapshot, double w)
+    {
+        const auto z1 = std::polar(1.0, -w);
+        const auto z2 = std::polar(1.0, -2.0 * w);
+        std::complex<double> h = 1.0;
+        for (int section = 0; section < snapshot.num_sections; ++section)
+        {
+            const auto& c = snapshot.sections[static_cast<size_t>(section)];
+            h *= (c.b0 + c.b1 * z1 + c.b2 * z2) / (1.0 + c.a1 * z1 + c.a2 * z2);
+        }
+        return h;
+    }
+
+    void check(const Snapshot& snapshot)
+    {
+        const auto terms = makeTerms(snapshot.sample_rate);
+        std::vector<float> magnitude(NUM_POINTS), phase(NUM_POINTS), delay(NUM_POINTS);
+        evaluateResponse(snapshot, terms.data(), terms.size(), { magnitude.data(), phase.data(), delay.data() });
+
+        double magnitude_error = 0.0, phase_error = 0.0, delay_error = 0.0;
+        for (size_t i = 0; i < NUM_POINTS; ++i)
+        {
+            const double w = 2.0 * PI * frequencyAt(i, snapshot.sample_rate) / snapshot.sample_rate;
+            const auto h = reference(snapshot, w);
+
+            magnitude_error = std::max(magnitude_error, std::abs(magnitude[i] - 20.0 * std::log10(std::abs(h))));
+            magnitude_error = std::max(magnitude_error, std::abs(magnitude[i] - magnitudedB(snapshot, terms[i])));
+
+            // Compared on the circle, so -180 and 180 agree
+            const double phase_difference = std::arg(std::polar(1.0, phase[i] * PI / 180.0) / h) * 180.0 / PI;
+            phase_error = std::max(phase_error, std::abs(phase_difference));
+
+            // -d(phase)/dw, from the ratio so the central difference never wraps
+            const double dw = 1e-6;
+            const double expected_samples = -std::arg(reference(snapshot, w + dw) / reference(snapshot, w - dw)) / (2.0 * dw);
+            const double expected_ms = expected_samples * 1000.0 / snapshot.sample_rate;
+            delay_error = std::max(delay_error, std::abs(delay[i] - expected_ms) / std::max(std::abs(expected_ms), 1e-3));
+        }
+
+        expectLessOrEqual(magnitude_error, MAX_MAGNITUDE_ERROR_DB, "magnitude");
+        expectLessOrEqual(phase_error, MAX_PHASE_ERROR_DEGREES, "phase");
+        expectLessOrEqual(delay_error, MAX_DELAY_ERROR, "group delay");
+
+        _magnitude_error = std::max(_magnitude_error, magnitude_error);
+        _phase_error = std::max(_phase_error, phase_error);
+        _delay_error = std::max(_delay_error, delay_error);
+    }
+
+    double _magnitude_error = 0.0;
+    double _phase_error = 0.0;
+    double _delay_error = 0.0;
+};
+
+static FrequencyResponseTests frequency_response_tests;
@@ -0,0 +1,48 @@
+#include <iostream>
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+//==============================================================================
+// Runs the FilterPlugin unit tests: every juce::UnitTest in the
+// "FilterPlugin" category, or only the ones named on the command line.
+// Returns non-zero if any expectation failed, so ctest picks it up.
+//
+// Usage: FilterTests [<test name> ...]
+int main(int argc, char* argv[])
+{
+    // The processor tests need a message manager for the parameter tree
+    juce::ScopedJuceInitialiser_GUI juce_initialiser;
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+
+    if (argc > 1)
+    {
+        juce::Array<juce::UnitTest*> tests;
+        for (int i = 1; i < argc; ++i)
+        {
+            for (auto* test : juce::UnitTest::getTestsInCategory("FilterPlugin"))
+            {
+                if (test->getName() == juce::String(argv[i]))
+                    tests.add(test);
+            }
+        }
+        if (tests.isEmpty())
+        {
+            std::cerr << "No FilterPlugin test with that name" << std::endl;
+            return 1;
+        }
+        runner.runTests(tests);
+    }
+    else
+    {
+        runner.runTestsInCategory("FilterPlugin");
+    }
+
+    int failures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+    {
+        failures += runner.getResult(i)->failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "../FilterPlugin/PluginProcessor.h"
+
+//==============================================================================
+// getStateInformation / setStateInformation between two processors: the
+// parameters, the program bank with its names, and the current program's
+// unsaved edits all have to come back. States from a newer format version
+// must be refused and leave the processor as it was.
+class PluginStateTests : public juce::UnitTest
+{
+public:
+    PluginStateTests() : juce::UnitTest("PluginState", "FilterPlugin") {}
+
+    void runTest() override
+    {
+        beginTest("State round-trips through a new instance");
+
+        FilterPluginAudioProcessor original;
+        setParameter(original, "fc", 2500.0f);
+        setParameter(original, "Q", 1.5f);
+        setParameter(original, "boost_cut", -6.0f);
+        setParameter(original, "filter_type", 4.0f);
+        setParameter(original, "oversampling", 2.0f);
+        setParameter(original, "topology", 1.0f);
+        original.changeProgramName(2, "Bright");
+
+        // Program 0 is stored when switching away, program 2 is only edited
+        original.setCurrentProgram(2);
+        setParameter(original, "fc", 8000.0f);
+        setParameter(original, "slope", 1.0f);
+
+        juce::MemoryBlock state;
+        original.getStateInformation(state);
+
+        FilterPluginAudioProcessor restored;
+        restored.setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+
+        expectEquals(restored.getCurrentProgram(), 2);
+        expectEquals(restored.getProgramName(2), juce::String("Bright"));
+        expectEquals(restored.getProgramName(0), original.getProgramName(0));
+        expectParameter(restored, "fc", 8000.0f);
+        expectParameter(restored, "slope", 1.0f);
+        expectParameter(restored, "Q", 1.5f);
+        expectParameter(restored, "oversampling", 2.0f);
+        expectParameter(restored, "topology", 1.0f);
+
+        beginTest("Programs come back with their own settings");
+
+        restored.setCurrentProgram(0);
+        expectParameter(restored, "fc", 2500.0f);
+        expectParameter(restored, "Q", 1.5f);
+        expectParameter(restored, "boost_cut", -6.0f);
+        expectParameter(restored, "filter_type", 4.0f);
+        expectParameter(restored, "slope", 0.0f);
+
+        // The edits that were only on the parameters when saving
+        restored.setCurrentProgram(2);
+        expectParameter(restored, "fc", 8000.0f);
+        expectParameter(restored, "slope", 1.0f);
+
+        beginTest("Saving twice gives the same state");
+
+        juce::MemoryBlock again;
+        original.getStateInformation(again);
+        expect(again == state, "saving changed the state");
+
+        beginTest("States from a newer version are refused");
+
+        auto tree = readState(state.getData(), static_cast<int>(state.getSize()));
+        expect(tree.isValid(), "the current version was refused");
+        tree.setProperty(STATE_VERSION_ID, STATE_VERSION + 1, nullptr);
+
+        juce::MemoryBlock newer;
+        {
+            juce::MemoryOutputStream stream(newer, false);
+            stream.writeInt(STATE_MAGIC);
+            stream.writeInt(STATE_VERSION + 1);
+            tree.writeToStream(stream);
+        }
+        expect(!readState(newer.getData(), static_cast<int>(newer.getSize())).isValid(), "binary");
+
+        const auto xml = tree.toXmlString();
+        expect(!readState(xml.toRawUTF8(), static_cast<int>(xml.getNumBytesAsUTF8())).isValid(), "XML");
+
+        FilterPluginAudioProcessor untouched;
+        const auto fc = untouched.getParameterState()->getRawParameterValue("fc")->load();
+        untouched.setStateInformation(newer.getData(), static_cast<int>(newer.getSize()));
+        expectParameter(untouched, "fc", fc);
+        expectEquals(untouched.getProgramName(2), juce::String("Program 3"));
+    }
+
+private:
+    static void setParameter(FilterPluginAudioProcessor& processor, const juce::String& id, float value)
+    {
+        auto* parameter = processor.getParameterState()->getParameter(id);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    void expectParameter(FilterPluginAudioProcessor& processor, const juce::String& id, float expected)
+    {
+        const auto value = processor.getParameterState()->getRawParameterValue(id)->load();
+        expectWithinAbsoluteError(value, expected, 1.0e-3f * std::max(1.0f, std::abs(expected)), id);
+    }
+};
+
+static PluginStateTests plugin_state_tests;